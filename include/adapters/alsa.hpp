@@ -61,7 +61,7 @@ class alsa_ctl_interface {
   }
 
   ~alsa_ctl_interface() {
-    std::lock_guard<threading_util::spin_lock> guard(m_lock);
+    std::lock_guard<threading_util::adaptive_lock> guard(m_lock);
     snd_ctl_close(m_ctl);
     snd_hctl_close(m_hctl);
   }
@@ -73,7 +73,7 @@ class alsa_ctl_interface {
   bool wait(int timeout = -1) {
     assert(m_ctl);
 
-    std::lock_guard<threading_util::spin_lock> guard(m_lock);
+    std::lock_guard<threading_util::adaptive_lock> guard(m_lock);
 
     int err = 0;
 
@@ -97,7 +97,7 @@ class alsa_ctl_interface {
     assert(m_elem);
     assert(m_value);
 
-    std::lock_guard<threading_util::spin_lock> guard(m_lock);
+    std::lock_guard<threading_util::adaptive_lock> guard(m_lock);
 
     int err = 0;
     if ((err = snd_hctl_elem_read(m_elem, m_value)) < 0)
@@ -112,7 +112,7 @@ class alsa_ctl_interface {
  private:
   int m_numid = 0;
 
-  threading_util::spin_lock m_lock;
+  threading_util::adaptive_lock m_lock;
 
   snd_hctl_t* m_hctl = nullptr;
   snd_hctl_elem_t* m_elem = nullptr;
@@ -154,7 +154,7 @@ class alsa_mixer {
   }
 
   ~alsa_mixer() {
-    std::lock_guard<threading_util::spin_lock> guard(m_lock);
+    std::lock_guard<threading_util::adaptive_lock> guard(m_lock);
     snd_mixer_elem_remove(m_mixerelement);
     snd_mixer_detach(m_hardwaremixer, ALSA_SOUNDCARD);
     snd_mixer_close(m_hardwaremixer);
@@ -167,7 +167,7 @@ class alsa_mixer {
   bool wait(int timeout = -1) {
     assert(m_hardwaremixer);
 
-    std::unique_lock<threading_util::spin_lock> guard(m_lock);
+    std::unique_lock<threading_util::adaptive_lock> guard(m_lock);
 
     int err = 0;
 
@@ -180,7 +180,7 @@ class alsa_mixer {
   }
 
   int process_events() {
-    std::lock_guard<threading_util::spin_lock> guard(m_lock);
+    std::lock_guard<threading_util::adaptive_lock> guard(m_lock);
 
     int num_events = snd_mixer_handle_events(m_hardwaremixer);
 
@@ -191,7 +191,7 @@ class alsa_mixer {
   }
 
   int get_volume() {
-    std::lock_guard<threading_util::spin_lock> guard(m_lock);
+    std::lock_guard<threading_util::adaptive_lock> guard(m_lock);
     long chan_n = 0, vol_total = 0, vol, vol_min, vol_max;
 
     snd_mixer_selem_get_playback_volume_range(m_mixerelement, &vol_min, &vol_max);
@@ -213,7 +213,7 @@ class alsa_mixer {
     if (is_muted())
       return;
 
-    std::lock_guard<threading_util::spin_lock> guard(m_lock);
+    std::lock_guard<threading_util::adaptive_lock> guard(m_lock);
 
     long vol_min, vol_max;
 
@@ -222,19 +222,19 @@ class alsa_mixer {
   }
 
   void set_mute(bool mode) {
-    std::lock_guard<threading_util::spin_lock> guard(m_lock);
+    std::lock_guard<threading_util::adaptive_lock> guard(m_lock);
     snd_mixer_selem_set_playback_switch_all(m_mixerelement, mode);
   }
 
   void toggle_mute() {
-    std::lock_guard<threading_util::spin_lock> guard(m_lock);
+    std::lock_guard<threading_util::adaptive_lock> guard(m_lock);
     int state;
     snd_mixer_selem_get_playback_switch(m_mixerelement, SND_MIXER_SCHN_MONO, &state);
     snd_mixer_selem_set_playback_switch_all(m_mixerelement, !state);
   }
 
   bool is_muted() {
-    std::lock_guard<threading_util::spin_lock> guard(m_lock);
+    std::lock_guard<threading_util::adaptive_lock> guard(m_lock);
     int state = 0;
     for (int i = 0; i <= SND_MIXER_SCHN_LAST; i++) {
       if (snd_mixer_selem_has_playback_channel(
@@ -251,7 +251,7 @@ class alsa_mixer {
  private:
   string m_name;
 
-  threading_util::spin_lock m_lock;
+  threading_util::adaptive_lock m_lock;
 
   snd_mixer_t* m_hardwaremixer = nullptr;
   snd_mixer_elem_t* m_mixerelement = nullptr;
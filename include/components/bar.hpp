@@ -1,6 +1,8 @@
 #pragma once
 
 #include <xcb/xcb_icccm.h>
+#include <algorithm>
+#include <condition_variable>
 #include <mutex>
 
 #include "common.hpp"
@@ -12,6 +14,7 @@
 #include "components/x11/connection.hpp"
 #include "components/x11/draw.hpp"
 #include "components/x11/fontmanager.hpp"
+#include "components/x11/imagemanager.hpp"
 #include "components/x11/randr.hpp"
 #include "components/x11/tray.hpp"
 #include "components/x11/types.hpp"
@@ -29,39 +32,67 @@
 
 LEMONBUDDY_NS
 
-class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::property_notify> {
+class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::property_notify,
+                 evt::visibility_notify, evt::map_notify, evt::unmap_notify,
+                 evt::randr_screen_change_notify, evt::randr_notify> {
  public:
   /**
    * Construct bar
    */
   explicit bar(connection& conn, const config& config, const logger& logger,
-      unique_ptr<fontmanager> fontmanager)
+      unique_ptr<fontmanager> fontmanager, unique_ptr<imagemanager> imagemanager)
       : m_connection(conn)
       , m_conf(config)
       , m_log(logger)
-      , m_fontmanager(forward<decltype(fontmanager)>(fontmanager)) {}
+      , m_fontmanager(forward<decltype(fontmanager)>(fontmanager))
+      , m_imagemanager(forward<decltype(imagemanager)>(imagemanager)) {}
 
   /**
    * Cleanup signal handlers and destroy the bar window
    */
   ~bar() {
-    std::lock_guard<threading_util::spin_lock> lck(m_lock);
+    if (m_marqueethread.joinable()) {
+      {
+        std::lock_guard<std::mutex> guard(m_marqueemtx);
+        m_scrolling = false;
+      }
+      m_marqueecond.notify_all();
+      m_marqueethread.join();
+    }
+
+    std::lock_guard<threading_util::adaptive_lock> lck(m_lock);
 
     // Disconnect signal handlers {{{
-    g_signals::parser::alignment_change = nullptr;
-    g_signals::parser::attribute_set = nullptr;
-    g_signals::parser::attribute_unset = nullptr;
-    g_signals::parser::attribute_toggle = nullptr;
-    g_signals::parser::action_block_open = nullptr;
-    g_signals::parser::action_block_close = nullptr;
-    g_signals::parser::color_change = nullptr;
-    g_signals::parser::font_change = nullptr;
-    g_signals::parser::pixel_offset = nullptr;
-    g_signals::parser::ascii_text_write = nullptr;
-    g_signals::parser::unicode_text_write = nullptr;
-    g_signals::tray::report_slotcount = nullptr;
+    std::unique_lock<std::mutex> parserlck(parser_mutex());
+    if (parser_owner() == this) {
+      parser_owner() = nullptr;
+      g_signals::parser::alignment_change = nullptr;
+      g_signals::parser::attribute_set = nullptr;
+      g_signals::parser::attribute_unset = nullptr;
+      g_signals::parser::attribute_toggle = nullptr;
+      g_signals::parser::action_block_open = nullptr;
+      g_signals::parser::action_block_close = nullptr;
+      g_signals::parser::slot_open = nullptr;
+      g_signals::parser::slot_close = nullptr;
+      g_signals::parser::marquee_open = nullptr;
+      g_signals::parser::marquee_close = nullptr;
+      g_signals::parser::color_change = nullptr;
+      g_signals::parser::font_change = nullptr;
+      g_signals::parser::pixel_offset = nullptr;
+      g_signals::parser::ascii_text_write = nullptr;
+      g_signals::parser::unicode_text_write = nullptr;
+      g_signals::parser::image_write = nullptr;
+    }
+    parserlck.unlock();
+    if (m_primary) {
+      g_signals::tray::report_slotcount = nullptr;
+      g_signals::bar::obscured_change = nullptr;
+      g_signals::bar::output_change = nullptr;
+    }
     // }}}
 
+    release_marquees(m_marquees);
+
     if (m_sinkattached)
       m_connection.detach_sink(this, 1);
     m_window.destroy();
@@ -71,8 +102,14 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
    * Create required components
    *
    * This is done outside the constructor due to boost::di noexcept
+   *
+   * @param nodraw Skip creating the window
+   * @param monitor_name Output to place the bar on, taken from the config if empty
+   * @param primary Only the primary bar holds the tray and watches the root window
    */
-  void bootstrap(bool nodraw = false) {  //{{{
+  void bootstrap(bool nodraw = false, string monitor_name = "", bool primary = true) {  //{{{
+    m_primary = primary;
+
     // limit the amount of allowed input events to 1 per 60ms
     m_throttler = throttle_util::make_throttler(1, 60ms);
 
@@ -86,9 +123,10 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
     if (monitors.empty())
       throw application_error("No monitors found");
 
-    auto monitor_name = m_conf.get<string>(bs, "monitor", "");
-    if (monitor_name.empty())
-      monitor_name = monitors[0]->name;
+    if (monitor_name.empty()) {
+      auto names = randr_util::match_monitors(monitors, m_conf.get<string>(bs, "monitor", ""));
+      monitor_name = names.empty() ? monitors[0]->name : names[0];
+    }
 
     for (auto&& monitor : monitors) {
       if (monitor_name.compare(monitor->name) == 0) {
@@ -149,38 +187,7 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
     GET_CONFIG_VALUE(bs, m_bar.module_margin_left, "module-margin-left");
     GET_CONFIG_VALUE(bs, m_bar.module_margin_right, "module-margin-right");
 
-    auto w = m_conf.get<string>(bs, "width", "100%");
-    auto h = m_conf.get<string>(bs, "height", "24");
-
-    m_bar.width = std::atoi(w.c_str());
-    if (w.find("%") != string::npos)
-      m_bar.width = m_bar.monitor->w * (m_bar.width / 100.0) + 0.5f;
-
-    m_bar.height = std::atoi(h.c_str());
-    if (h.find("%") != string::npos)
-      m_bar.height = m_bar.monitor->h * (m_bar.height / 100.0) + 0.5f;
-
-    // apply offsets
-    m_bar.x = m_bar.offset_x + m_bar.monitor->x;
-    m_bar.y = m_bar.offset_y + m_bar.monitor->y;
-
-    // apply borders
-    m_bar.height += m_borders[border::TOP].size;
-    m_bar.height += m_borders[border::BOTTOM].size;
-
-    if (m_bar.bottom)
-      m_bar.y = m_bar.monitor->y + m_bar.monitor->h - m_bar.height - m_bar.offset_y;
-
-    if (m_bar.width <= 0 || m_bar.width > m_bar.monitor->w)
-      throw application_error("Resulting bar width is out of bounds");
-    if (m_bar.height <= 0 || m_bar.height > m_bar.monitor->h)
-      throw application_error("Resulting bar height is out of bounds");
-
-    m_bar.width = math_util::cap<int>(m_bar.width, 0, m_bar.monitor->w);
-    m_bar.height = math_util::cap<int>(m_bar.height, 0, m_bar.monitor->h);
-
-    m_bar.vertical_mid =
-        (m_bar.height + m_borders[border::TOP].size - m_borders[border::BOTTOM].size) / 2;
+    calculate_geometry();
 
     m_log.trace("bar: Resulting bar geom %ix%i+%i+%i", m_bar.width, m_bar.height, m_bar.x, m_bar.y);
 
@@ -196,6 +203,7 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
 
     m_bar.separator = string_util::trim(m_conf.get<string>(bs, "separator", ""), '"');
     m_bar.locale = m_conf.get<string>(bs, "locale", "");
+    m_marqueeinterval = chrono::milliseconds{m_conf.get<int>(bs, "marquee-interval", 50)};
 
     // }}}
     // Checking nodraw {{{
@@ -210,7 +218,7 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
 
     m_log.trace("bar: Create colormap");
     {
-      m_connection.create_colormap_checked(
+      m_connection.create_colormap(
           XCB_COLORMAP_ALLOC_NONE, m_colormap, m_screen->root, m_visual->visual_id);
     }
 
@@ -223,11 +231,15 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
       XCB_AUX_ADD_PARAM(&mask, &params, border_pixel, 0);
       XCB_AUX_ADD_PARAM(&mask, &params, colormap, m_colormap);
       XCB_AUX_ADD_PARAM(&mask, &params, override_redirect, m_bar.dock);
-      XCB_AUX_ADD_PARAM(&mask, &params, event_mask, XCB_EVENT_MASK_PROPERTY_CHANGE | XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_BUTTON_PRESS);
+      XCB_AUX_ADD_PARAM(&mask, &params, event_mask, XCB_EVENT_MASK_PROPERTY_CHANGE | XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_VISIBILITY_CHANGE | XCB_EVENT_MASK_STRUCTURE_NOTIFY);
       // clang-format on
       m_window.create_checked(m_bar.x, m_bar.y, m_bar.width, m_bar.height, mask, &params);
+      m_connection.count_roundtrip();
     }
 
+    // The remaining requests are not checked, to avoid waiting for the server after each
+    // of them. Failures are reported as errors by the event loop.
+
     m_log.trace("bar: Set WM_NAME");
     {
       xcb_icccm_set_wm_name(
@@ -238,61 +250,41 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
     m_log.trace("bar: Set _NET_WM_WINDOW_TYPE");
     {
       const uint32_t win_types[1] = {_NET_WM_WINDOW_TYPE_DOCK};
-      m_connection.change_property_checked(
+      m_connection.change_property(
           XCB_PROP_MODE_REPLACE, m_window, _NET_WM_WINDOW_TYPE, XCB_ATOM_ATOM, 32, 1, win_types);
     }
 
     m_log.trace("bar: Set _NET_WM_STATE");
     {
       const uint32_t win_states[2] = {_NET_WM_STATE_STICKY, _NET_WM_STATE_ABOVE};
-      m_connection.change_property_checked(
+      m_connection.change_property(
           XCB_PROP_MODE_REPLACE, m_window, _NET_WM_STATE, XCB_ATOM_ATOM, 32, 2, win_states);
     }
 
     m_log.trace("bar: Set _NET_WM_STRUT_PARTIAL");
-    {
-      uint32_t none{0};
-      uint32_t value_list[12]{none};
-
-      if (m_bar.bottom) {
-        value_list[3] = m_bar.height;
-        value_list[10] = m_bar.x;
-        value_list[11] = m_bar.x + m_bar.width;
-      } else {
-        value_list[2] = m_bar.height;
-        value_list[8] = m_bar.x;
-        value_list[9] = m_bar.x + m_bar.width;
-      }
-
-      m_connection.change_property_checked(XCB_PROP_MODE_REPLACE, m_window, _NET_WM_STRUT_PARTIAL,
-          XCB_ATOM_CARDINAL, 32, 12, value_list);
-    }
+    { set_strut(); }
 
     m_log.trace("bar: Set _NET_WM_DESKTOP");
     {
       const uint32_t value_list[1]{-1u};
-      m_connection.change_property_checked(
+      m_connection.change_property(
           XCB_PROP_MODE_REPLACE, m_window, _NET_WM_DESKTOP, XCB_ATOM_CARDINAL, 32, 1, value_list);
     }
 
     m_log.trace("bar: Set _NET_WM_PID");
     {
       const uint32_t value_list[1]{uint32_t(getpid())};
-      m_connection.change_property_checked(
+      m_connection.change_property(
           XCB_PROP_MODE_REPLACE, m_window, _NET_WM_PID, XCB_ATOM_CARDINAL, 32, 1, value_list);
     }
 
     m_log.trace("bar: Create pixmap");
-    {
-      m_connection.create_pixmap_checked(
-          m_visual->visual_id == m_screen->root_visual ? XCB_COPY_FROM_PARENT : 32, m_pixmap,
-          m_window, m_bar.width, m_bar.height);
-    }
+    { create_pixmap(); }
 
     m_log.trace("bar: Map window");
     {
+      m_connection.map_window(m_window);
       m_connection.flush();
-      m_connection.map_window_checked(m_window);
     }
 
     // }}}
@@ -353,8 +345,13 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
         XCB_AUX_ADD_PARAM(&mask, &params, graphics_exposures, 0);
         xutils::pack_values(mask, &params, value_list);
         m_gcontexts.emplace(gc(i), gcontext{m_connection, m_connection.generate_id()});
-        m_connection.create_gc_checked(m_gcontexts.at(gc(i)), m_pixmap, mask, value_list);
+        m_connection.create_gc(m_gcontexts.at(gc(i)), m_pixmap, mask, value_list);
       }
+
+      m_colors.emplace(gc::BG, m_bar.background);
+      m_colors.emplace(gc::FG, m_bar.foreground);
+      m_colors.emplace(gc::UL, m_bar.linecolor);
+      m_colors.emplace(gc::OL, m_bar.linecolor);
     }
 
     // }}}
@@ -392,7 +389,7 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
     // Set tray settings {{{
 
     try {
-      auto tray_position = m_conf.get<string>(bs, "tray-position");
+      auto tray_position = m_primary ? m_conf.get<string>(bs, "tray-position") : "none";
 
       if (tray_position == "left")
         m_tray.align = alignment::LEFT;
@@ -420,12 +417,8 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
       }
 
       m_tray.width = m_tray.height;
-      m_tray.orig_y = m_bar.y + m_borders.at(border::TOP).size;
 
-      if (m_tray.align == alignment::RIGHT)
-        m_tray.orig_x = m_bar.x + m_bar.width - m_borders.at(border::RIGHT).size;
-      else
-        m_tray.orig_x = m_bar.x + m_borders.at(border::LEFT).size;
+      update_tray_origin();
     }
 
     m_tray.sibling = m_window;
@@ -433,20 +426,6 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
     // }}}
     // Connect signal handlers {{{
 
-    // clang-format off
-    g_signals::parser::alignment_change = bind(&bar::on_alignment_change, this, std::placeholders::_1);
-    g_signals::parser::attribute_set = bind(&bar::on_attribute_set, this, std::placeholders::_1);
-    g_signals::parser::attribute_unset = bind(&bar::on_attribute_unset, this, std::placeholders::_1);
-    g_signals::parser::attribute_toggle = bind(&bar::on_attribute_toggle, this, std::placeholders::_1);
-    g_signals::parser::action_block_open = bind(&bar::on_action_block_open, this, std::placeholders::_1, std::placeholders::_2);
-    g_signals::parser::action_block_close = bind(&bar::on_action_block_close, this, std::placeholders::_1);
-    g_signals::parser::color_change = bind(&bar::on_color_change, this, std::placeholders::_1, std::placeholders::_2);
-    g_signals::parser::font_change = bind(&bar::on_font_change, this, std::placeholders::_1);
-    g_signals::parser::pixel_offset = bind(&bar::on_pixel_offset, this, std::placeholders::_1);
-    g_signals::parser::ascii_text_write = bind(&bar::draw_character, this, std::placeholders::_1);
-    g_signals::parser::unicode_text_write = bind(&bar::draw_character, this, std::placeholders::_1);
-    // clang-format on
-
     if (m_tray.align != alignment::NONE)
       g_signals::tray::report_slotcount = bind(&bar::on_tray_report, this, std::placeholders::_1);
 
@@ -458,6 +437,82 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
     m_connection.flush();
   }  //}}}
 
+  /**
+   * Move and resize the window after the geometry of its output changed
+   *
+   * The window and pixmap are reused. The current contents are
+   * dropped so that the next input is drawn from scratch.
+   *
+   * @return false if the bar geometry is unchanged
+   */
+  bool reconfigure(const monitor_t& monitor) {  //{{{
+    std::lock_guard<threading_util::adaptive_lock> lck(m_lock);
+
+    auto previous = m_bar;
+    m_bar.monitor = monitor;
+
+    try {
+      calculate_geometry();
+    } catch (const application_error& err) {
+      m_bar = previous;
+      throw;
+    }
+
+    if (m_bar.x == previous.x && m_bar.y == previous.y && m_bar.width == previous.width &&
+        m_bar.height == previous.height)
+      return false;
+
+    m_log.info("Output %s changed, moving bar to %ix%i+%i+%i", monitor->name, m_bar.width,
+        m_bar.height, m_bar.x, m_bar.y);
+
+    const uint32_t value_list[4]{static_cast<uint32_t>(m_bar.x), static_cast<uint32_t>(m_bar.y),
+        static_cast<uint32_t>(m_bar.width), static_cast<uint32_t>(m_bar.height)};
+    m_connection.configure_window(m_window,
+        XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH |
+            XCB_CONFIG_WINDOW_HEIGHT,
+        value_list);
+
+    set_strut();
+
+    if (m_tray.align != alignment::NONE)
+      update_tray_origin();
+
+    if (m_bar.width != previous.width || m_bar.height != previous.height) {
+      m_connection.free_pixmap(m_pixmap);
+      create_pixmap();
+    }
+
+    release_marquees(m_marquees);
+    m_actions.clear();
+    m_slots.clear();
+    m_prevlayout.clear();
+    m_prevdata.clear();
+
+    return true;
+  }  //}}}
+
+  /**
+   * Read the images from disk again and redraw everything on the next
+   * input, used when the configuration is reloaded in place
+   */
+  void reload_images() {  //{{{
+    std::lock_guard<threading_util::adaptive_lock> lck(m_lock);
+    m_imagemanager->clear();
+    m_prevlayout.clear();
+    m_prevdata.clear();
+  }  //}}}
+
+  /**
+   * Pause or resume scrolling the marquees while the bar can't be seen
+   */
+  void suspend(bool state) {  //{{{
+    {
+      std::lock_guard<std::mutex> guard(m_marqueemtx);
+      m_suspended = state;
+    }
+    m_marqueecond.notify_all();
+  }  //}}}
+
   /**
    * Parse input string and redraw the bar window
    *
@@ -465,18 +520,33 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
    * @param force Unless true, do not parse unchanged data
    */
   void parse(string data, bool force = false) {  //{{{
-    std::lock_guard<threading_util::spin_lock> lck(m_lock);
+    std::lock_guard<threading_util::adaptive_lock> lck(m_lock);
     {
       if (data == m_prevdata && !force)
         return;
 
+      // The parser signals are shared, only one bar can parse at a time
+      std::lock_guard<std::mutex> parserlck(parser_mutex());
+      connect_parser();
+
+      vector<string> slots;
+      auto layout = split_slots(data, slots);
+
       m_prevdata = data;
 
       // TODO: move to fontmanager
       m_xftdraw = XftDrawCreate(xlib::get_display(), m_pixmap, xlib::get_visual(), m_colormap);
 
+      if (!force && redraw_slots(layout, slots)) {
+        XftDrawDestroy(m_xftdraw);
+        return;
+      }
+
+      m_prevlayout = layout;
+
       m_bar.align = alignment::LEFT;
       m_xpos = m_borders[border::LEFT].size;
+      m_xlimit = m_bar.width;
       m_attributes = 0;
 
 #if DEBUG and DRAW_CLICKABLE_AREA_HINTS
@@ -486,6 +556,13 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
 #endif
 
       m_actions.clear();
+      m_slots.clear();
+      m_activeslot = -1;
+
+      // Keep the previous marquees around so that their pixmaps can be reused
+      m_prevmarquees = move(m_marquees);
+      m_marquees.clear();
+      m_activemarquee = -1;
 
       draw_background();
 
@@ -499,6 +576,15 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
         m_log.err("Unrecognized syntax token '%s'", err.what());
       }
 
+      release_marquees(m_prevmarquees);
+
+      // Slots can only be redrawn in place when they map to the input
+      if (m_slots.size() == slots.size()) {
+        for (size_t i = 0; i < slots.size(); i++) m_slots[i].contents = slots[i];
+      } else {
+        m_slots.clear();
+      }
+
       if (m_tray.align == alignment::RIGHT && m_tray.slots)
         draw_shift(m_xpos, ((m_tray.width + m_tray.spacing) * m_tray.slots) + m_tray.spacing);
 
@@ -507,23 +593,28 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
       flush();
 
       XftDrawDestroy(m_xftdraw);
+
+      auto& textruns = m_fontmanager->textrun_cache();
+      m_log.trace("bar: Text width cache hit rate %.1f%% (hits: %lu, misses: %lu, entries: %lu)",
+          textruns.hit_rate(), textruns.hits(), textruns.misses(), textruns.size());
     }
   }  //}}}
 
   /**
    * Copy the contents of the pixmap's onto the bar window
+   *
+   * @param x Start of the region to copy
+   * @param w Width of the region to copy, 0 copies until the end of the bar
    */
-  void flush() {  //{{{
-    m_connection.copy_area(
-        m_pixmap, m_window, m_gcontexts.at(gc::FG), 0, 0, 0, 0, m_bar.width, m_bar.height);
-    m_connection.copy_area(
-        m_pixmap, m_window, m_gcontexts.at(gc::BT), 0, 0, 0, 0, m_bar.width, m_bar.height);
-    m_connection.copy_area(
-        m_pixmap, m_window, m_gcontexts.at(gc::BB), 0, 0, 0, 0, m_bar.width, m_bar.height);
-    m_connection.copy_area(
-        m_pixmap, m_window, m_gcontexts.at(gc::BL), 0, 0, 0, 0, m_bar.width, m_bar.height);
-    m_connection.copy_area(
-        m_pixmap, m_window, m_gcontexts.at(gc::BR), 0, 0, 0, 0, m_bar.width, m_bar.height);
+  void flush(int16_t x = 0, uint16_t w = 0) {  //{{{
+    if (w == 0)
+      w = m_bar.width - x;
+
+    m_connection.copy_area(m_pixmap, m_window, m_gcontexts.at(gc::FG), x, 0, x, 0, w, m_bar.height);
+    m_connection.copy_area(m_pixmap, m_window, m_gcontexts.at(gc::BT), x, 0, x, 0, w, m_bar.height);
+    m_connection.copy_area(m_pixmap, m_window, m_gcontexts.at(gc::BB), x, 0, x, 0, w, m_bar.height);
+    m_connection.copy_area(m_pixmap, m_window, m_gcontexts.at(gc::BL), x, 0, x, 0, w, m_bar.height);
+    m_connection.copy_area(m_pixmap, m_window, m_gcontexts.at(gc::BR), x, 0, x, 0, w, m_bar.height);
     m_connection.flush();
 
 #if DEBUG and DRAW_CLICKABLE_AREA_HINTS
@@ -564,6 +655,54 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
     }
   }  //}}}
 
+  /**
+   * Reuse the rendered output of another bar window
+   *
+   * Only possible when both windows have the same size, hold
+   * no tray icons and the output has no scrolling marquees
+   *
+   * @return false if the input needs to be parsed instead
+   */
+  bool mirror(bar& source, const string& data) {  //{{{
+    if (&source == this)
+      return false;
+
+    std::lock_guard<threading_util::adaptive_lock> lck(m_lock);
+    std::lock_guard<threading_util::adaptive_lock> srclck(source.m_lock);
+
+    if (source.m_prevdata != data)
+      return false;
+    if (source.m_bar.width != m_bar.width || source.m_bar.height != m_bar.height)
+      return false;
+    if (!source.m_marquees.empty() || !m_marquees.empty())
+      return false;
+    if (source.m_tray.slots != m_tray.slots)
+      return false;
+
+    if (data != m_prevdata) {
+      m_connection.copy_area(source.m_pixmap, m_pixmap, m_gcontexts.at(gc::FG), 0, 0, 0, 0,
+          m_bar.width, m_bar.height);
+
+      m_prevdata = data;
+      m_actions = source.m_actions;
+
+      // Slots belong to the parsed layout, the next parse starts over
+      m_slots.clear();
+      m_prevlayout.clear();
+
+      flush();
+    }
+
+    return true;
+  }  //}}}
+
+  /**
+   * Check if the bar window is unmapped or fully covered
+   */
+  bool obscured() const {  // {{{
+    return m_obscured;
+  }  // }}}
+
   /**
    * Get the bar settings container
    */
@@ -586,7 +725,7 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
       return;
     }
 
-    std::lock_guard<threading_util::spin_lock> lck(m_lock);
+    std::lock_guard<threading_util::adaptive_lock> lck(m_lock);
     {
       m_log.trace_x("bar: Received button press event: %i at pos(%i, %i)",
           static_cast<int>(evt->detail), evt->event_x, evt->event_y);
@@ -617,7 +756,7 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
         m_log.trace_x("action.end_x = %i", action.end_x);
 
         if (g_signals::bar::action_click)
-          g_signals::bar::action_click(action.command);
+          g_signals::bar::action_click(action.command, m_bar.monitor->name);
         else
           m_log.warn("No signal handler's connected to 'action_click'");
 
@@ -653,8 +792,11 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
    * it's not really any overhead worth talking about.
    */
   void handle(const evt::property_notify& evt) {  // {{{
-    if (evt->window == m_window && evt->atom == WM_STATE) {
-      if (!g_signals::bar::visibility_change)
+    if (evt->window == m_connection.root() && evt->atom == XCB_ATOM_RESOURCE_MANAGER) {
+      if (m_primary && g_signals::bar::xresources_change)
+        g_signals::bar::xresources_change();
+    } else if (evt->window == m_window && evt->atom == WM_STATE) {
+      if (!m_primary || !g_signals::bar::visibility_change)
         return;
 
       try {
@@ -673,6 +815,67 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
     }
   }  // }}}
 
+  /**
+   * Event handler for XCB_VISIBILITY_NOTIFY events
+   */
+  void handle(const evt::visibility_notify& evt) {  // {{{
+    if (evt->window != m_window)
+      return;
+    m_log.trace("bar: Received visibility_notify (state: %i)", evt->state);
+    m_fullyobscured = evt->state == XCB_VISIBILITY_FULLY_OBSCURED;
+    update_obscured();
+  }  // }}}
+
+  /**
+   * Event handler for XCB_MAP_NOTIFY events
+   */
+  void handle(const evt::map_notify& evt) {  // {{{
+    if (evt->window != m_window)
+      return;
+    m_log.trace("bar: Received map_notify");
+    m_unmapped = false;
+    update_obscured();
+  }  // }}}
+
+  /**
+   * Event handler for XCB_UNMAP_NOTIFY events
+   */
+  void handle(const evt::unmap_notify& evt) {  // {{{
+    if (evt->window != m_window)
+      return;
+    m_log.trace("bar: Received unmap_notify");
+    m_unmapped = true;
+    update_obscured();
+  }  // }}}
+
+  /**
+   * Event handler for XCB_RANDR_SCREEN_CHANGE_NOTIFY events
+   */
+  void handle(const evt::randr_screen_change_notify&) {  // {{{
+    if (!m_primary)
+      return;
+    m_log.trace("bar: Received randr_screen_change_notify");
+    if (g_signals::bar::output_change)
+      g_signals::bar::output_change();
+  }  // }}}
+
+  /**
+   * Event handler for XCB_RANDR_NOTIFY events
+   *
+   * Sent for crtc and output changes, such as a new mode or a
+   * connected display
+   */
+  void handle(const evt::randr_notify& evt) {  // {{{
+    if (!m_primary)
+      return;
+    if (evt->subCode != XCB_RANDR_NOTIFY_CRTC_CHANGE &&
+        evt->subCode != XCB_RANDR_NOTIFY_OUTPUT_CHANGE)
+      return;
+    m_log.trace("bar: Received randr_notify");
+    if (g_signals::bar::output_change)
+      g_signals::bar::output_change();
+  }  // }}}
+
  protected:
   /**
    * Handle alignment update
@@ -752,26 +955,171 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
         continue;
 
       action.active = false;
+      block_position(action.align, action.start_x, action.end_x);
+
+      return;
+    }
+  }  //}}}
+
+  /**
+   * Handle slot start
+   */
+  void on_slot_open(int min_width, int max_width, bool ellipsis) {  //{{{
+    m_log.trace_x("bar: slot_open(%i, %i, %i)", min_width, max_width, ellipsis);
+
+    if (m_activeslot != -1) {
+      m_log.warn("Ignoring nested slot");
+      return;
+    }
+
+    slot_block slot;
+    slot.min_width = min_width;
+    slot.max_width = max_width;
+    slot.ellipsis = ellipsis;
+    slot.align = m_bar.align;
+    slot.start_x = m_xpos;
+    slot.attributes = m_attributes;
+    slot.fontindex = m_fontindex;
+    slot.colors = m_colors;
+
+    m_activeslot = m_slots.size();
+    m_slots.emplace_back(slot);
+  }  //}}}
+
+  /**
+   * Handle slot end
+   */
+  void on_slot_close() {  //{{{
+    m_log.trace_x("bar: slot_close()");
+
+    if (m_activeslot == -1)
+      return;
+
+    auto& slot = m_slots[m_activeslot];
+    m_activeslot = -1;
+
+    pad_slot(slot);
+
+    slot.active = false;
+    block_position(slot.align, slot.start_x, slot.end_x);
+  }  //}}}
+
+  /**
+   * Handle marquee start
+   */
+  void on_marquee_open(int width) {  //{{{
+    m_log.trace_x("bar: marquee_open(%i)", width);
+
+    if (m_activemarquee != -1) {
+      m_log.warn("Ignoring nested marquee");
+      return;
+    }
+
+    marquee_block marquee;
+    marquee.width = width;
+    marquee.align = m_bar.align;
+    marquee.start_x = m_xpos;
+
+    m_activemarquee = m_marquees.size();
+    m_marquees.emplace_back(marquee);
+  }  //}}}
+
+  /**
+   * Handle marquee end
+   *
+   * Text that doesn't fit is rendered once into an offscreen pixmap
+   * from which the scroll thread copies the visible part
+   */
+  void on_marquee_close() {  //{{{
+    m_log.trace_x("bar: marquee_close()");
+
+    if (m_activemarquee == -1)
+      return;
+
+    auto& marquee = m_marquees[m_activemarquee];
+    m_activemarquee = -1;
+
+    vector<std::pair<font_t*, vector<uint32_t>>> runs;
+    int text_width = 0;
+
+    for (auto&& glyph : marquee.glyphs) {
+      auto& font = m_fontmanager->match_char(glyph);
+      if (!font)
+        continue;
+      if (runs.empty() || runs.back().first != &font)
+        runs.emplace_back(&font, vector<uint32_t>{});
+      runs.back().second.emplace_back(glyph);
+    }
+
+    for (auto&& run : runs) {
+      text_width += m_fontmanager->text_extents(*run.first, run.second).width;
+    }
+
+    if (text_width <= marquee.width) {
+      int16_t start_x = marquee.start_x;
+      int16_t width = marquee.width;
+      m_marquees.pop_back();
 
-      if (action.align == alignment::LEFT) {
-        action.end_x = m_xpos;
-      } else if (action.align == alignment::CENTER) {
-        int base_x = m_bar.width;
-        base_x -= m_borders[border::RIGHT].size;
-        base_x /= 2;
-        base_x += m_borders[border::LEFT].size;
-
-        int clickable_width = m_xpos - action.start_x;
-        action.start_x = base_x - clickable_width / 2 + action.start_x / 2;
-        action.end_x = action.start_x + clickable_width;
-      } else if (action.align == alignment::RIGHT) {
-        int base_x = m_bar.width - m_borders[border::RIGHT].size;
-        action.start_x = base_x - m_xpos + action.start_x;
-        action.end_x = base_x;
+      for (auto&& run : runs) {
+        draw_glyphs(*run.first, run.second);
+      }
+
+      if (m_xpos - start_x < width) {
+        draw_shift(m_xpos, width - (m_xpos - start_x));
+        m_xpos = start_x + width;
       }
 
       return;
     }
+
+    marquee.key = marquee_key(marquee.glyphs);
+
+    for (auto&& prev : m_prevmarquees) {
+      if (prev.pixmap && prev.key == marquee.key) {
+        marquee.pixmap = prev.pixmap;
+        marquee.text_width = prev.text_width;
+        marquee.offset = prev.offset;
+        prev.pixmap = 0;
+        break;
+      }
+    }
+
+    if (!marquee.pixmap) {
+      // Leave a gap before the text starts over
+      marquee.text_width = text_width + m_bar.height;
+      marquee.pixmap = m_connection.generate_id();
+
+      m_connection.create_pixmap(
+          m_visual->visual_id == m_screen->root_visual ? XCB_COPY_FROM_PARENT : 32,
+          marquee.pixmap, m_window, marquee.text_width, m_bar.height);
+      draw_util::fill(m_connection, marquee.pixmap, m_gcontexts.at(gc::BG), 0, 0,
+          marquee.text_width, m_bar.height);
+
+      auto xftdraw =
+          XftDrawCreate(xlib::get_display(), marquee.pixmap, xlib::get_visual(), m_colormap);
+      int x = 0;
+
+      for (auto&& run : runs) {
+        int width = m_fontmanager->text_extents(*run.first, run.second).width;
+        prepare_font(*run.first);
+        render_glyphs(marquee.pixmap, xftdraw, *run.first, run.second, x);
+        draw_lines(marquee.pixmap, x, width);
+        x += width;
+      }
+
+      XftDrawDestroy(xftdraw);
+    }
+
+    copy_marquee(marquee, draw_shift(m_xpos, marquee.width));
+    m_xpos += marquee.width;
+
+    marquee.active = false;
+    block_position(marquee.align, marquee.start_x, marquee.end_x);
+
+    if (!m_marqueethread.joinable()) {
+      m_scrolling = true;
+      m_marqueethread = thread(&bar::marquee_runner, this);
+    }
   }  //}}}
 
   /**
@@ -781,6 +1129,9 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
     m_log.trace_x(
         "bar: color_change(%i, %s -> %s)", static_cast<int>(gc_), color_.hex(), color_.rgb());
 
+    m_colors.erase(gc_);
+    m_colors.emplace(gc_, color_);
+
     const uint32_t value_list[32]{color_.value()};
     m_connection.change_gc(m_gcontexts.at(gc_), XCB_GC_FOREGROUND, value_list);
 
@@ -795,6 +1146,7 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
    */
   void on_font_change(int index) {  //{{{
     m_log.trace_x("bar: font_change(%i)", index);
+    m_fontindex = index;
     m_fontmanager->set_preferred_font(index);
   }  //}}}
 
@@ -803,6 +1155,14 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
    */
   void on_pixel_offset(int px) {  //{{{
     m_log.trace_x("bar: pixel_offset(%i)", px);
+
+    if (m_activeslot != -1 && m_slots[m_activeslot].max_width > 0 && px > 0) {
+      auto& slot = m_slots[m_activeslot];
+      px = std::min(px, slot.max_width - (m_xpos - slot.start_x));
+      if (px <= 0)
+        return;
+    }
+
     draw_shift(m_xpos, px);
     m_xpos += px;
   }  //}}}
@@ -880,18 +1240,18 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
   }  //}}}
 
   /**
-   * Draw over- and underline onto the pixmap
+   * Draw over- and underline onto the drawable
    */
-  void draw_lines(int x, int w) {  //{{{
+  void draw_lines(xcb_drawable_t drawable, int x, int w) {  //{{{
     if (!m_bar.lineheight)
       return;
 
     if (m_attributes & static_cast<int>(attribute::o))
-      draw_util::fill(m_connection, m_pixmap, m_gcontexts.at(gc::OL), x,
+      draw_util::fill(m_connection, drawable, m_gcontexts.at(gc::OL), x,
           m_borders[border::TOP].size, w, m_bar.lineheight);
 
     if (m_attributes & static_cast<int>(attribute::u))
-      draw_util::fill(m_connection, m_pixmap, m_gcontexts.at(gc::UL), x,
+      draw_util::fill(m_connection, drawable, m_gcontexts.at(gc::UL), x,
           m_bar.height - m_borders[border::BOTTOM].size - m_bar.lineheight, w, m_bar.lineheight);
   }  //}}}
 
@@ -917,77 +1277,671 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
     }
 
     draw_util::fill(
-        m_connection, m_pixmap, m_gcontexts.at(gc::BG), x, 0, m_bar.width - x, m_bar.height);
+        m_connection, m_pixmap, m_gcontexts.at(gc::BG), x, 0, m_xlimit - x, m_bar.height);
 
     // Translate pos of clickable areas
-    if (m_bar.align != alignment::LEFT)
+    if (m_bar.align != alignment::LEFT) {
       for (auto&& action : m_actions) {
         if (action.active || action.align != m_bar.align)
           continue;
         action.start_x -= delta;
         action.end_x -= delta;
       }
+      for (auto&& slot : m_slots) {
+        if (slot.active || slot.align != m_bar.align)
+          continue;
+        slot.start_x -= delta;
+        slot.end_x -= delta;
+      }
+      for (auto&& marquee : m_marquees) {
+        if (marquee.active || marquee.align != m_bar.align)
+          continue;
+        marquee.start_x -= delta;
+        marquee.end_x -= delta;
+      }
+    }
 
     return x;
   }  //}}}
 
   /**
-   * Draw text contents
+   * Draw a run of ascii characters, grouped by matching font
    */
-  void draw_character(uint16_t character) {  // {{{
-    // TODO: cache
-    auto& font = m_fontmanager->match_char(character);
-
-    if (!font) {
-      m_log.warn("No suitable font found for character at index %i", character);
+  void draw_textstring(string text) {  // {{{
+    if (m_activemarquee != -1) {
+      auto& marquee = m_marquees[m_activemarquee];
+      marquee.glyphs.insert(marquee.glyphs.end(), text.begin(), text.end());
       return;
     }
 
-    if (font->ptr && font->ptr != m_gcfont) {
-      m_gcfont = font->ptr;
-      m_fontmanager->set_gcontext_font(m_gcontexts.at(gc::FG), m_gcfont);
-    }
+    vector<uint32_t> glyphs;
+    font_t* glyphfont{nullptr};
 
-    if (font->ptr && m_xfont_color != 0) {
-      m_log.trace_x("bar: Set gcontext color for xcb font");
-      const uint32_t values[1]{m_xfont_color};
-      m_connection.change_gc(m_gcontexts.at(gc::FG), XCB_GC_FOREGROUND, values);
-      m_xfont_color = 0;
-    }
+    glyphs.reserve(text.length());
 
-    // TODO: cache
-    auto chr_width = m_fontmanager->char_width(font, character);
+    for (auto&& c : text) {
+      auto& font = m_fontmanager->match_char(static_cast<uint8_t>(c));
 
-    // Avoid odd glyph width's for center-aligned text
-    // since it breaks the positioning of clickable area's
-    if (m_bar.align == alignment::CENTER && chr_width % 2)
-      chr_width++;
+      if (&font != glyphfont && !glyphs.empty()) {
+        draw_glyphs(*glyphfont, glyphs);
+        glyphs.clear();
+      }
 
-    auto x = draw_shift(m_xpos, chr_width);
-    auto y = m_bar.vertical_mid + font->height / 2 - font->descent + font->offset_y;
+      glyphfont = &font;
+      glyphs.emplace_back(static_cast<uint8_t>(c));
+    }
 
-    // m_log.trace("Draw char(%c, width: %i) at pos(%i,%i)", character, chr_width, x, y);
+    if (!glyphs.empty())
+      draw_glyphs(*glyphfont, glyphs);
+  }  // }}}
 
-    if (font->xft != nullptr) {
-      auto color = m_fontmanager->xftcolor();
-      XftDrawString16(m_xftdraw, &color, font->xft, x, y, &character, 1);
-    } else {
-      character = (character >> 8) | (character << 8);
-      draw_util::xcb_poly_text_16_patched(
-          m_connection, m_pixmap, m_gcontexts.at(gc::FG), x, y, 1, &character);
+  /**
+   * Draw a single unicode character
+   */
+  void draw_character(uint32_t character) {  // {{{
+    if (m_activemarquee != -1) {
+      m_marquees[m_activemarquee].glyphs.emplace_back(character);
+      return;
     }
 
-    draw_lines(x, chr_width);
-    m_xpos += chr_width;
+    draw_glyphs(m_fontmanager->match_char(character), {character});
   }  // }}}
 
- private:
-  connection& m_connection;
-  const config& m_conf;
-  const logger& m_log;
+  /**
+   * Draw an image, vertically centered on the bar
+   */
+  void draw_image(string path) {  // {{{
+    // Marquees only scroll text
+    if (m_activemarquee != -1)
+      return;
+
+    auto img = m_imagemanager->get(path);
+
+    if (img == nullptr)
+      return;
+
+    int width = img->width;
+
+    if (m_activeslot != -1 && m_slots[m_activeslot].max_width > 0) {
+      auto& slot = m_slots[m_activeslot];
+      if (slot.overflowed || width > slot.max_width - (m_xpos - slot.start_x)) {
+        slot.overflowed = true;
+        return;
+      }
+    }
+
+    if (m_bar.align == alignment::CENTER && width % 2)
+      width++;
+
+    auto x = draw_shift(m_xpos, width);
+    auto y = m_bar.vertical_mid - img->height / 2;
+
+    m_imagemanager->composite(*img, XftDrawPicture(m_xftdraw), x, y);
+    draw_lines(m_pixmap, x, width);
+    m_xpos += width;
+  }  // }}}
+
+  /**
+   * Draw a run of characters, clipped to the width of the active slot
+   */
+  void draw_glyphs(font_t& font, const vector<uint32_t>& glyphs) {  // {{{
+    if (!font || m_activeslot == -1 || m_slots[m_activeslot].max_width <= 0)
+      return draw_run(font, glyphs);
+
+    auto& slot = m_slots[m_activeslot];
+
+    if (slot.overflowed)
+      return;
+
+    int available = slot.max_width - (m_xpos - slot.start_x);
+
+    if (m_fontmanager->text_extents(font, glyphs).width <= available)
+      return draw_run(font, glyphs);
+
+    slot.overflowed = true;
+
+    // Use U+2026 if any font provides it, otherwise three dots
+    vector<uint32_t> ellipsis{0x2026};
+    font_t* ellipsis_font = &m_fontmanager->match_char(ellipsis[0]);
+    int ellipsis_width = 0;
+
+    if (!*ellipsis_font) {
+      ellipsis = {'.', '.', '.'};
+      ellipsis_font = &font;
+    }
+
+    if (slot.ellipsis)
+      ellipsis_width = m_fontmanager->text_extents(*ellipsis_font, ellipsis).width;
+
+    auto& extents = m_fontmanager->text_extents(font, glyphs);
+    size_t len = 0;
+
+    while (len < glyphs.size()) {
+      int glyph_end = len + 1 < glyphs.size() ? extents.offsets[len + 1] : extents.width;
+      if (glyph_end > available - ellipsis_width)
+        break;
+      len++;
+    }
+
+    if (len > 0)
+      draw_run(font, vector<uint32_t>(glyphs.begin(), glyphs.begin() + len));
+
+    if (slot.ellipsis && ellipsis_width <= slot.max_width - (m_xpos - slot.start_x))
+      draw_run(*ellipsis_font, ellipsis);
+  }  // }}}
+
+  /**
+   * Draw a run of characters using the given font
+   */
+  void draw_run(font_t& font, const vector<uint32_t>& glyphs) {  // {{{
+    if (!font) {
+      m_log.warn("No suitable font found for character at index %i", glyphs[0]);
+      return;
+    }
+
+    prepare_font(font);
+
+    // Avoid odd widths for center-aligned text
+    // since it breaks the positioning of clickable area's
+    int run_width = m_fontmanager->text_extents(font, glyphs).width;
+    if (m_bar.align == alignment::CENTER && run_width % 2)
+      run_width++;
+
+    auto x = draw_shift(m_xpos, run_width);
+
+    render_glyphs(m_pixmap, m_xftdraw, font, glyphs, x);
+    draw_lines(m_pixmap, x, run_width);
+    m_xpos += run_width;
+  }  // }}}
+
+  /**
+   * Make sure the gcontext uses the given font and current color
+   */
+  void prepare_font(font_t& font) {  // {{{
+    if (font->ptr && font->ptr != m_gcfont) {
+      m_gcfont = font->ptr;
+      m_fontmanager->set_gcontext_font(m_gcontexts.at(gc::FG), m_gcfont);
+    }
+
+    if (font->ptr && m_xfont_color != 0) {
+      m_log.trace_x("bar: Set gcontext color for xcb font");
+      const uint32_t values[1]{m_xfont_color};
+      m_connection.change_gc(m_gcontexts.at(gc::FG), XCB_GC_FOREGROUND, values);
+      m_xfont_color = 0;
+    }
+  }  // }}}
+
+  /**
+   * Render glyphs onto the drawable at given position
+   */
+  void render_glyphs(xcb_drawable_t drawable, XftDraw* xftdraw, font_t& font,
+      const vector<uint32_t>& glyphs, int x) {  // {{{
+    auto y = m_bar.vertical_mid + font->height / 2 - font->descent + font->offset_y;
+
+    if (font->xft != nullptr) {
+      auto color = m_fontmanager->xftcolor();
+      XftDrawString32(xftdraw, &color, font->xft, x, y, glyphs.data(), glyphs.size());
+    } else {
+      auto& extents = m_fontmanager->text_extents(font, glyphs);
+
+      // Core fonts only cover the BMP and each text item holds at most 254 glyphs
+      uint16_t chars[254];
+
+      for (size_t i = 0; i < glyphs.size(); i += 254) {
+        uint8_t len = std::min<size_t>(glyphs.size() - i, 254);
+        for (uint8_t n = 0; n < len; n++) {
+          auto chr = static_cast<uint16_t>(glyphs[i + n]);
+          chars[n] = (chr >> 8) | (chr << 8);
+        }
+        draw_util::xcb_poly_text_16_patched(m_connection, drawable, m_gcontexts.at(gc::FG),
+            x + extents.offsets[i], y, len, chars);
+      }
+    }
+  }  // }}}
+
+  /**
+   * Get the final position of a closed action or slot block
+   */
+  void block_position(alignment align, int16_t& start_x, int16_t& end_x) {  //{{{
+    if (align == alignment::LEFT) {
+      end_x = m_xpos;
+    } else if (align == alignment::CENTER) {
+      int base_x = m_bar.width;
+      base_x -= m_borders[border::RIGHT].size;
+      base_x /= 2;
+      base_x += m_borders[border::LEFT].size;
+
+      int block_width = m_xpos - start_x;
+      start_x = base_x - block_width / 2 + start_x / 2;
+      end_x = start_x + block_width;
+    } else if (align == alignment::RIGHT) {
+      int base_x = m_bar.width - m_borders[border::RIGHT].size;
+      start_x = base_x - m_xpos + start_x;
+      end_x = base_x;
+    }
+  }  //}}}
+
+  /**
+   * Pad the slot contents to its minimum width
+   */
+  void pad_slot(slot_block& slot) {  //{{{
+    int width = m_xpos - slot.start_x;
+    int target = std::max<int>(width, slot.min_width);
+
+    if (slot.max_width > 0)
+      target = std::min<int>(target, slot.max_width);
+
+    if (target > width) {
+      draw_shift(m_xpos, target - width);
+      m_xpos += target - width;
+    }
+  }  //}}}
+
+  /**
+   * Split input into its layout and the contents of each slot
+   *
+   * The layout is the input with all slot contents removed. Slot tags
+   * that have been merged with other tags, i.e. %{F- S-}, are moved
+   * into a block of their own.
+   */
+  string split_slots(const string& data, vector<string>& contents) {  //{{{
+    string layout;
+    bool in_slot{false};
+    size_t pos = 0;
+
+    while (pos < data.length()) {
+      size_t start = data.find("%{", pos);
+      size_t end = start != string::npos ? data.find('}', start) : string::npos;
+
+      if (end == string::npos)
+        break;
+
+      string block{data.substr(start + 2, end - start - 2)};
+      size_t tag_start = 0;
+      size_t tag_end;
+
+      (in_slot ? contents.back() : layout) += data.substr(pos, start - pos);
+
+      while (tag_start <= block.length()) {
+        if ((tag_end = block.find(' ', tag_start)) == string::npos)
+          tag_end = block.length();
+
+        string tag{block.substr(tag_start, tag_end - tag_start)};
+        bool is_open{!in_slot && tag.length() > 1 && tag[0] == 'S' && isdigit(tag[1])};
+        bool is_close{in_slot && tag == "S-"};
+
+        if (is_open || is_close) {
+          auto before = string_util::trim(block.substr(0, tag_start), ' ');
+          if (!before.empty())
+            (in_slot ? contents.back() : layout) += "%{" + before + "}";
+
+          layout += "%{" + tag + "}";
+
+          if ((in_slot = is_open))
+            contents.emplace_back();
+
+          block.erase(0, tag_end);
+          tag_start = 0;
+        } else {
+          tag_start = tag_end + 1;
+        }
+      }
+
+      block = string_util::trim(block, ' ');
+      if (!block.empty())
+        (in_slot ? contents.back() : layout) += "%{" + block + "}";
+
+      pos = end + 1;
+    }
+
+    (in_slot ? contents.back() : layout) += data.substr(pos);
+
+    // Discard unterminated slots
+    if (in_slot) {
+      contents.clear();
+      return data;
+    }
+
+    return layout;
+  }  //}}}
+
+  /**
+   * Redraw the contents of changed fixed-width slots in place,
+   * leaving the rest of the bar and its clickable areas untouched
+   *
+   * @return false if a full redraw is required
+   */
+  bool redraw_slots(const string& layout, const vector<string>& contents) {  //{{{
+    if (m_slots.empty() || layout != m_prevlayout || contents.size() != m_slots.size())
+      return false;
+
+    vector<size_t> changed;
+
+    for (size_t i = 0; i < m_slots.size(); i++) {
+      if (m_slots[i].contents == contents[i])
+        continue;
+      if (m_slots[i].active || m_slots[i].max_width <= 0 ||
+          m_slots[i].min_width != m_slots[i].max_width)
+        return false;
+      changed.emplace_back(i);
+    }
+
+    auto colors = m_colors;
+    auto attributes = m_attributes;
+    auto fontindex = m_fontindex;
+    auto align = m_bar.align;
+
+    int16_t region_start = m_bar.width;
+    int16_t region_end = 0;
+
+    for (auto&& i : changed) {
+      auto& slot = m_slots[i];
+
+      m_log.trace_x("bar: Redraw slot %lu in place (%i -> %i)", i, slot.start_x, slot.end_x);
+
+      restore_state(slot.colors, slot.attributes, slot.fontindex);
+
+      // Drop the clickable areas within the slot
+      m_actions.erase(std::remove_if(m_actions.begin(), m_actions.end(),
+                          [&](const action_block& action) {
+                            return action.start_x >= slot.start_x && action.end_x <= slot.end_x;
+                          }),
+          m_actions.end());
+
+      // Keep the marquees within the slot around so that their pixmaps can be reused
+      for (auto it = m_marquees.begin(); it != m_marquees.end();) {
+        if (it->start_x >= slot.start_x && it->end_x <= slot.end_x) {
+          m_prevmarquees.emplace_back(move(*it));
+          it = m_marquees.erase(it);
+        } else {
+          it++;
+        }
+      }
+
+      m_bar.align = alignment::LEFT;
+      m_xpos = slot.start_x;
+      m_xlimit = slot.end_x;
+      m_activeslot = i;
+
+      slot.overflowed = false;
+      slot.contents = contents[i];
+
+      draw_util::fill(m_connection, m_pixmap, m_gcontexts.at(gc::BG), slot.start_x, 0,
+          slot.end_x - slot.start_x, m_bar.height);
+
+      try {
+        parser parser(m_bar);
+        parser(slot.contents);
+      } catch (const unrecognized_token& err) {
+        m_log.err("Unrecognized syntax token '%s'", err.what());
+      }
+
+      pad_slot(slot);
+
+      m_activeslot = -1;
+      region_start = std::min(region_start, slot.start_x);
+      region_end = std::max(region_end, slot.end_x);
+    }
+
+    release_marquees(m_prevmarquees);
+    restore_state(colors, attributes, fontindex);
+
+    m_bar.align = align;
+    m_xlimit = m_bar.width;
+
+    if (region_end > region_start) {
+      draw_border(border::ALL);
+      flush(region_start, region_end - region_start);
+    }
+
+    return true;
+  }  //}}}
+
+  /**
+   * Restore the colors, attributes and font used for drawing
+   */
+  void restore_state(const map<gc, color>& colors, int attributes, int fontindex) {  //{{{
+    for (auto&& color_ : colors) {
+      auto current = m_colors.find(color_.first);
+      if (current == m_colors.end() || current->second.value() != color_.second.value())
+        on_color_change(color_.first, color_.second);
+    }
+
+    m_attributes = attributes;
+    on_font_change(fontindex);
+  }  //}}}
+
+  /**
+   * Get the key used to look up the pixmap of a rendered marquee
+   */
+  string marquee_key(const vector<uint32_t>& glyphs) {  //{{{
+    string key;
+    for (auto&& color_ : m_colors) key += color_.second.hex();
+    key += ":" + to_string(m_attributes) + ":" + to_string(m_fontindex) + ":";
+    key.append(reinterpret_cast<const char*>(glyphs.data()), glyphs.size() * sizeof(uint32_t));
+    return key;
+  }  //}}}
+
+  /**
+   * Copy the visible part of the marquee onto the bar pixmap
+   */
+  void copy_marquee(const marquee_block& marquee, int x) {  //{{{
+    int y = m_borders[border::TOP].size;
+    int h = m_bar.height - m_borders[border::TOP].size - m_borders[border::BOTTOM].size;
+    int w = std::min<int>(marquee.width, marquee.text_width - marquee.offset);
+
+    m_connection.copy_area(
+        marquee.pixmap, m_pixmap, m_gcontexts.at(gc::FG), marquee.offset, y, x, y, w, h);
+
+    if (w < marquee.width)
+      m_connection.copy_area(
+          marquee.pixmap, m_pixmap, m_gcontexts.at(gc::FG), 0, y, x + w, y, marquee.width - w, h);
+  }  //}}}
+
+  /**
+   * Free the pixmaps of the given marquees
+   */
+  void release_marquees(vector<marquee_block>& marquees) {  //{{{
+    for (auto&& marquee : marquees) {
+      if (marquee.pixmap)
+        m_connection.free_pixmap(marquee.pixmap);
+    }
+    marquees.clear();
+  }  //}}}
+
+  /**
+   * Calculate the window geometry from the configured size and the output
+   */
+  void calculate_geometry() {  //{{{
+    auto bs = m_conf.bar_section();
+    auto w = m_conf.get<string>(bs, "width", "100%");
+    auto h = m_conf.get<string>(bs, "height", "24");
+
+    m_bar.width = std::atoi(w.c_str());
+    if (w.find("%") != string::npos)
+      m_bar.width = m_bar.monitor->w * (m_bar.width / 100.0) + 0.5f;
+
+    m_bar.height = std::atoi(h.c_str());
+    if (h.find("%") != string::npos)
+      m_bar.height = m_bar.monitor->h * (m_bar.height / 100.0) + 0.5f;
+
+    // apply offsets
+    m_bar.x = m_bar.offset_x + m_bar.monitor->x;
+    m_bar.y = m_bar.offset_y + m_bar.monitor->y;
+
+    // apply borders
+    m_bar.height += m_borders[border::TOP].size;
+    m_bar.height += m_borders[border::BOTTOM].size;
+
+    if (m_bar.bottom)
+      m_bar.y = m_bar.monitor->y + m_bar.monitor->h - m_bar.height - m_bar.offset_y;
+
+    if (m_bar.width <= 0 || m_bar.width > m_bar.monitor->w)
+      throw application_error("Resulting bar width is out of bounds");
+    if (m_bar.height <= 0 || m_bar.height > m_bar.monitor->h)
+      throw application_error("Resulting bar height is out of bounds");
+
+    m_bar.width = math_util::cap<int>(m_bar.width, 0, m_bar.monitor->w);
+    m_bar.height = math_util::cap<int>(m_bar.height, 0, m_bar.monitor->h);
+
+    m_bar.vertical_mid =
+        (m_bar.height + m_borders[border::TOP].size - m_borders[border::BOTTOM].size) / 2;
+  }  //}}}
+
+  /**
+   * Reserve the space taken by the bar on its output
+   */
+  void set_strut() {  //{{{
+    uint32_t none{0};
+    uint32_t value_list[12]{none};
+
+    if (m_bar.bottom) {
+      value_list[3] = m_bar.height;
+      value_list[10] = m_bar.x;
+      value_list[11] = m_bar.x + m_bar.width;
+    } else {
+      value_list[2] = m_bar.height;
+      value_list[8] = m_bar.x;
+      value_list[9] = m_bar.x + m_bar.width;
+    }
+
+    m_connection.change_property(XCB_PROP_MODE_REPLACE, m_window, _NET_WM_STRUT_PARTIAL,
+        XCB_ATOM_CARDINAL, 32, 12, value_list);
+  }  //}}}
+
+  /**
+   * Create the pixmap that the bar contents are drawn onto
+   */
+  void create_pixmap() {  //{{{
+    m_connection.create_pixmap(
+        m_visual->visual_id == m_screen->root_visual ? XCB_COPY_FROM_PARENT : 32, m_pixmap,
+        m_window, m_bar.width, m_bar.height);
+  }  //}}}
+
+  /**
+   * Place the tray at the configured edge of the bar
+   */
+  void update_tray_origin() {  //{{{
+    m_tray.orig_y = m_bar.y + m_borders.at(border::TOP).size;
+
+    if (m_tray.align == alignment::RIGHT)
+      m_tray.orig_x = m_bar.x + m_bar.width - m_borders.at(border::RIGHT).size;
+    else
+      m_tray.orig_x = m_bar.x + m_borders.at(border::LEFT).size;
+  }  //}}}
+
+  /**
+   * Notify about changes to whether the bar window can be seen at all
+   */
+  void update_obscured() {  //{{{
+    bool obscured = m_unmapped || m_fullyobscured;
+
+    if (obscured == m_obscured)
+      return;
+
+    m_obscured = obscured;
+
+    if (g_signals::bar::obscured_change)
+      g_signals::bar::obscured_change(obscured);
+  }  //}}}
+
+  /**
+   * Route the parser signals to this bar
+   *
+   * The signals are shared by all bar windows, so they are
+   * connected to the bar that is about to parse its input
+   */
+  void connect_parser() {  //{{{
+    if (parser_owner() == this)
+      return;
+
+    parser_owner() = this;
+
+    // clang-format off
+    g_signals::parser::alignment_change = bind(&bar::on_alignment_change, this, std::placeholders::_1);
+    g_signals::parser::attribute_set = bind(&bar::on_attribute_set, this, std::placeholders::_1);
+    g_signals::parser::attribute_unset = bind(&bar::on_attribute_unset, this, std::placeholders::_1);
+    g_signals::parser::attribute_toggle = bind(&bar::on_attribute_toggle, this, std::placeholders::_1);
+    g_signals::parser::action_block_open = bind(&bar::on_action_block_open, this, std::placeholders::_1, std::placeholders::_2);
+    g_signals::parser::action_block_close = bind(&bar::on_action_block_close, this, std::placeholders::_1);
+    g_signals::parser::slot_open = bind(&bar::on_slot_open, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+    g_signals::parser::slot_close = bind(&bar::on_slot_close, this);
+    g_signals::parser::marquee_open = bind(&bar::on_marquee_open, this, std::placeholders::_1);
+    g_signals::parser::marquee_close = bind(&bar::on_marquee_close, this);
+    g_signals::parser::color_change = bind(&bar::on_color_change, this, std::placeholders::_1, std::placeholders::_2);
+    g_signals::parser::font_change = bind(&bar::on_font_change, this, std::placeholders::_1);
+    g_signals::parser::pixel_offset = bind(&bar::on_pixel_offset, this, std::placeholders::_1);
+    g_signals::parser::ascii_text_write = bind(&bar::draw_textstring, this, std::placeholders::_1);
+    g_signals::parser::unicode_text_write = bind(&bar::draw_character, this, std::placeholders::_1);
+    g_signals::parser::image_write = bind(&bar::draw_image, this, std::placeholders::_1);
+    // clang-format on
+  }  //}}}
+
+  /**
+   * Lock held while parsing the input of any bar
+   */
+  static std::mutex& parser_mutex() {  //{{{
+    static std::mutex mtx;
+    return mtx;
+  }  //}}}
+
+  /**
+   * Bar whose handlers are connected to the parser signals
+   */
+  static bar*& parser_owner() {  //{{{
+    static bar* owner{nullptr};
+    return owner;
+  }  //}}}
+
+  /**
+   * Scroll the marquees one pixel at a time
+   *
+   * Runs on its own clock, independent of the module updates
+   */
+  void marquee_runner() {  //{{{
+    m_log.trace("bar: Start marquee thread");
+
+    while (m_scrolling) {
+      {
+        std::unique_lock<std::mutex> guard(m_marqueemtx);
+        m_marqueecond.wait_for(guard, m_marqueeinterval);
+        m_marqueecond.wait(guard, [this] { return !m_suspended || !m_scrolling; });
+      }
+
+      if (!m_scrolling)
+        break;
+
+      std::lock_guard<threading_util::adaptive_lock> lck(m_lock);
+
+      int16_t region_start = m_bar.width;
+      int16_t region_end = 0;
+
+      for (auto&& marquee : m_marquees) {
+        if (marquee.active || !marquee.pixmap)
+          continue;
+
+        marquee.offset = (marquee.offset + 1) % marquee.text_width;
+        copy_marquee(marquee, marquee.start_x);
+
+        region_start = std::min(region_start, marquee.start_x);
+        region_end = std::max(region_end, marquee.end_x);
+      }
+
+      if (region_end > region_start)
+        flush(region_start, region_end - region_start);
+    }
+
+    m_log.trace("bar: Stop marquee thread");
+  }  //}}}
+
+ private:
+  connection& m_connection;
+  const config& m_conf;
+  const logger& m_log;
   unique_ptr<fontmanager> m_fontmanager;
+  unique_ptr<imagemanager> m_imagemanager;
 
-  threading_util::spin_lock m_lock;
+  threading_util::adaptive_lock m_lock;
   throttle_util::throttle_t m_throttler;
 
   xcb_screen_t* m_screen;
@@ -1002,12 +1956,33 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
   map<border, border_settings> m_borders;
   map<gc, gcontext> m_gcontexts;
   vector<action_block> m_actions;
+  vector<slot_block> m_slots;
+  int m_activeslot{-1};
+  vector<marquee_block> m_marquees;
+  vector<marquee_block> m_prevmarquees;
+  int m_activemarquee{-1};
+  map<gc, color> m_colors;
 
   stateflag m_sinkattached{false};
 
   string m_prevdata;
+  string m_prevlayout;
   int m_xpos{0};
+  int m_xlimit{0};
   int m_attributes{0};
+  int m_fontindex{0};
+
+  stateflag m_scrolling{false};
+  thread m_marqueethread;
+  std::mutex m_marqueemtx;
+  std::condition_variable m_marqueecond;
+  chrono::milliseconds m_marqueeinterval{50};
+
+  bool m_suspended{false};
+  bool m_unmapped{false};
+  bool m_fullyobscured{false};
+  stateflag m_obscured{false};
+  bool m_primary{true};
 
   uint32_t m_xfont_color{0};
   xcb_font_t m_gcfont{0};
@@ -1025,7 +2000,8 @@ namespace {
         configure_connection(),
         configure_config(),
         configure_logger(),
-        configure_fontmanager());
+        configure_fontmanager(),
+        configure_imagemanager());
     // clang-format on
   }
 }
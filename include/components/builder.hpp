@@ -18,6 +18,30 @@ LEMONBUDDY_NS
 
 using namespace drawtypes;
 
+/**
+ * Number of open tags and current value per tag type
+ */
+template <class T>
+struct tag_values {
+  T& operator[](syntaxtag tag) {
+    return values[static_cast<size_t>(tag)];
+  }
+
+  void reset() {
+    for (auto&& value : values) value = T{};
+  }
+
+  array<T, static_cast<size_t>(syntaxtag::u) + 1> values{};
+};
+
+/**
+ * Builds the formatted output of a module
+ *
+ * Everything is appended to a single buffer that keeps its storage
+ * between updates, and the open tags are counted as they are emitted,
+ * so building the same output again doesn't allocate except for the
+ * string returned by flush()
+ */
 class builder {
  public:
   explicit builder(const bar_settings bar, bool lazy = true) : m_bar(bar), m_lazy(lazy) {}
@@ -35,110 +59,102 @@ class builder {
       while (m_counters[syntaxtag::U] > 0) line_color_close(true);
       while (m_counters[syntaxtag::u] > 0) underline_close(true);
       while (m_counters[syntaxtag::o] > 0) overline_close(true);
+      while (m_counters[syntaxtag::S] > 0) slot_close(true);
     }
 
-    string output = m_output.data();
+    string output{m_output};
 
-    // reset values
+    // reset values, the buffer keeps its capacity for the next build
     m_output.clear();
-    for (auto& counter : m_counters) counter.second = 0;
-    for (auto& value : m_colors) value.second = "";
+    m_counters.reset();
+    m_colors.reset();
     m_fontindex = 1;
 
-    return string_util::replace_all(output, string{BUILDER_SPACE_TOKEN}, " ");
+    return output;
   }
 
-  void append(string text) {
-    string str(text);
-    auto len = str.length();
-    if (len > 2 && str[0] == '"' && str[len - 1] == '"')
-      m_output += str.substr(1, len - 2);
-    else
-      m_output += str;
+  void append(const string& text) {
+    append(text, 0, text.length());
   }
 
-  void node(string str, bool add_space = false) {
-    string::size_type n, m;
-    string s(str);
-
-    while (true) {
-      if (s.empty()) {
-        break;
+  void node(const string& str, bool add_space = false) {
+    string::size_type pos{0}, n, m;
 
-      } else if ((n = s.find("%{F-}")) == 0) {
+    while (pos < str.length()) {
+      if (str.compare(pos, 5, "%{F-}") == 0) {
         color_close(!m_lazy);
-        s.erase(0, 5);
+        pos += 5;
 
-      } else if ((n = s.find("%{F#")) == 0 && (m = s.find("}")) != string::npos) {
-        if (m - n - 4 == 2)
-          color_alpha(s.substr(n + 3, m - 3));
+      } else if (str.compare(pos, 4, "%{F#") == 0 && (m = str.find('}', pos)) != string::npos) {
+        if (m - pos - 4 == 2)
+          color_alpha(str.substr(pos + 3, m - pos - 3));
         else
-          color(s.substr(n + 3, m - 3));
-        s.erase(n, m + 1);
+          color(str.substr(pos + 3, m - pos - 3));
+        pos = m + 1;
 
-      } else if ((n = s.find("%{B-}")) == 0) {
+      } else if (str.compare(pos, 5, "%{B-}") == 0) {
         background_close(!m_lazy);
-        s.erase(0, 5);
+        pos += 5;
 
-      } else if ((n = s.find("%{B#")) == 0 && (m = s.find("}")) != string::npos) {
-        background(s.substr(n + 3, m - 3));
-        s.erase(n, m + 1);
+      } else if (str.compare(pos, 4, "%{B#") == 0 && (m = str.find('}', pos)) != string::npos) {
+        background(str.substr(pos + 3, m - pos - 3));
+        pos = m + 1;
 
-      } else if ((n = s.find("%{T-}")) == 0) {
+      } else if (str.compare(pos, 5, "%{T-}") == 0) {
         font_close(!m_lazy);
-        s.erase(0, 5);
+        pos += 5;
 
-      } else if ((n = s.find("%{T")) == 0 && (m = s.find("}")) != string::npos) {
-        font(std::atoi(s.substr(n + 3, m - 3).c_str()));
-        s.erase(n, m + 1);
+      } else if (str.compare(pos, 3, "%{T") == 0 && (m = str.find('}', pos)) != string::npos) {
+        font(std::atoi(str.c_str() + pos + 3));
+        pos = m + 1;
 
-      } else if ((n = s.find("%{U-}")) == 0) {
+      } else if (str.compare(pos, 5, "%{U-}") == 0) {
         line_color_close(!m_lazy);
-        s.erase(0, 5);
+        pos += 5;
 
-      } else if ((n = s.find("%{U#")) == 0 && (m = s.find("}")) != string::npos) {
-        line_color(s.substr(n + 3, m - 3));
-        s.erase(n, m + 1);
+      } else if (str.compare(pos, 4, "%{U#") == 0 && (m = str.find('}', pos)) != string::npos) {
+        line_color(str.substr(pos + 3, m - pos - 3));
+        pos = m + 1;
 
-      } else if ((n = s.find("%{+u}")) == 0) {
+      } else if (str.compare(pos, 5, "%{+u}") == 0) {
         underline();
-        s.erase(0, 5);
+        pos += 5;
 
-      } else if ((n = s.find("%{+o}")) == 0) {
+      } else if (str.compare(pos, 5, "%{+o}") == 0) {
         overline();
-        s.erase(0, 5);
+        pos += 5;
 
-      } else if ((n = s.find("%{-u}")) == 0) {
+      } else if (str.compare(pos, 5, "%{-u}") == 0) {
         underline_close(true);
-        s.erase(0, 5);
+        pos += 5;
 
-      } else if ((n = s.find("%{-o}")) == 0) {
+      } else if (str.compare(pos, 5, "%{-o}") == 0) {
         overline_close(true);
-        s.erase(0, 5);
+        pos += 5;
 
-      } else if ((n = s.find("%{A}")) == 0) {
+      } else if (str.compare(pos, 4, "%{A}") == 0) {
         cmd_close(true);
-        s.erase(0, 4);
+        pos += 4;
 
-      } else if ((n = s.find("%{")) == 0 && (m = s.find("}")) != string::npos) {
-        append(s.substr(n, m + 1));
-        s.erase(n, m + 1);
+      } else if (str.compare(pos, 2, "%{") == 0 && (m = str.find('}', pos)) != string::npos) {
+        append(str, pos, m - pos + 1);
+        pos = m + 1;
 
-      } else if ((n = s.find("%{")) > 0) {
-        append(s.substr(0, n));
-        s.erase(0, n);
+      } else if ((n = str.find("%{", pos)) != pos && n != string::npos) {
+        append(str, pos, n - pos);
+        pos = n;
 
-      } else
+      } else {
+        append(str, pos, str.length() - pos);
         break;
+      }
     }
 
-    if (!s.empty())
-      append(s);
     if (add_space)
       space();
   }
 
-  void node(string str, int font_index, bool add_space = false) {
+  void node(const string& str, int font_index, bool add_space = false) {
     font(font_index);
     node(str, add_space);
     font_close();
@@ -150,15 +166,13 @@ class builder {
   //   node(bar->get_output(math_util::cap<float>(0, 100, perc)), add_space);
   // }
 
-  void node(label_t label, bool add_space = false) {
+  void node(const label_t& label, bool add_space = false) {
     if (!label || !*label)
       return;
 
-    auto text = label->get();
-
-    if (label->m_maxlen > 0 && text.length() > label->m_maxlen) {
-      text = text.substr(0, label->m_maxlen) + "...";
-    }
+    // Marquee labels scroll within a fixed width instead of being truncated
+    auto& text = m_labeltext;
+    label->copy_to(text, label->m_marquee == 0 ? label->m_maxlen : 0);
 
     if ((label->m_overline.empty() && m_counters[syntaxtag::o] > 0) ||
         (m_counters[syntaxtag::o] > 0 && label->m_margin > 0))
@@ -181,7 +195,19 @@ class builder {
     if (label->m_padding > 0)
       space(label->m_padding);
 
-    node(text, label->m_font, add_space);
+    image(label->m_image);
+
+    if (label->m_marquee > 0 && !text.empty()) {
+      font(label->m_font);
+      marquee(label->m_marquee);
+      append(text);
+      marquee_close();
+      font_close();
+      if (add_space)
+        space();
+    } else {
+      node(text, label->m_font, add_space);
+    }
 
     if (label->m_padding > 0)
       space(label->m_padding);
@@ -220,8 +246,7 @@ class builder {
       width = m_bar.spacing;
     if (width <= 0)
       return;
-    string str(width, ' ');
-    append(str);
+    m_output.append(width, ' ');
   }
 
   void remove_trailing_space(int width = DEFAULT_SPACING) {
@@ -230,9 +255,10 @@ class builder {
     if (width <= 0)
       return;
     string::size_type spacing = width;
-    string str(spacing, ' ');
-    if (m_output.length() >= spacing && m_output.substr(m_output.length() - spacing) == str)
-      m_output = m_output.substr(0, m_output.length() - spacing);
+    if (m_output.length() < spacing)
+      return;
+    if (m_output.find_first_not_of(' ', m_output.length() - spacing) == string::npos)
+      m_output.resize(m_output.length() - spacing);
   }
 
   void invert() {
@@ -370,7 +396,7 @@ class builder {
       return;
 
     m_counters[syntaxtag::o]++;
-    append("%{+o}");
+    m_output += "%{+o}";
   }
 
   void overline_close(bool force = false) {
@@ -378,7 +404,7 @@ class builder {
       return;
 
     m_counters[syntaxtag::o]--;
-    append("%{-o}");
+    m_output += "%{-o}";
   }
 
   void underline(string color = "") {
@@ -388,7 +414,7 @@ class builder {
       return;
 
     m_counters[syntaxtag::u]++;
-    append("%{+u}");
+    m_output += "%{+u}";
   }
 
   void underline_close(bool force = false) {
@@ -396,66 +422,120 @@ class builder {
       return;
 
     m_counters[syntaxtag::u]--;
-    append("%{-u}");
+    m_output += "%{-u}";
+  }
+
+  void slot(int min_width, int max_width = 0, bool ellipsis = false) {
+    if (min_width <= 0 && max_width <= 0)
+      return;
+    m_output += "%{S";
+    m_output += std::to_string(min_width);
+    m_output += ':';
+    m_output += std::to_string(max_width);
+    m_output += ellipsis ? ":e}" : ":c}";
+    m_counters[syntaxtag::S]++;
+  }
+
+  void slot_close(bool force = false) {
+    if ((!force && m_lazy) || m_counters[syntaxtag::S] <= 0)
+      return;
+
+    m_counters[syntaxtag::S]--;
+    tag_close('S');
   }
 
-  void cmd(mousebtn index, string action, bool condition = true) {
+  void image(const string& path) {
+    if (!path.empty())
+      tag_open('I', path);
+  }
+
+  void marquee(int width) {
+    if (width <= 0)
+      return;
+    tag_open('M', std::to_string(width));
+    m_counters[syntaxtag::M]++;
+  }
+
+  void marquee_close() {
+    if (m_counters[syntaxtag::M] <= 0)
+      return;
+    m_counters[syntaxtag::M]--;
+    tag_close('M');
+  }
+
+  void cmd(mousebtn index, const string& action, bool condition = true) {
     int button = static_cast<int>(index);
 
     if (!condition || action.empty())
       return;
 
-    action = string_util::replace_all(action, ":", "\\:");
-    action = string_util::replace_all(action, "$", "\\$");
-    action = string_util::replace_all(action, "}", "\\}");
-    action = string_util::replace_all(action, "{", "\\{");
-    action = string_util::replace_all(action, "%", "\x0025");
+    m_output += "%{A";
+    m_output += std::to_string(button);
+    m_output += ':';
 
-    append("%{A" + std::to_string(button) + ":" + action + ":}");
+    for (auto&& c : action) {
+      if (c == ':' || c == '$' || c == '}' || c == '{')
+        m_output += '\\';
+      m_output += c;
+    }
+
+    m_output += ":}";
     m_counters[syntaxtag::A]++;
   }
 
   void cmd_close(bool force = false) {
     if (m_counters[syntaxtag::A] > 0 || force)
-      append("%{A}");
+      m_output += "%{A}";
     if (m_counters[syntaxtag::A] > 0)
       m_counters[syntaxtag::A]--;
   }
 
  protected:
-  void tag_open(char tag, string value) {
-    append("%{" + string({tag}) + value + "}");
+  /**
+   * Append part of the text, dropping surrounding quotes and
+   * replacing the space tokens while copying
+   */
+  void append(const string& text, size_t pos, size_t len) {
+    if (len > 2 && text[pos] == '"' && text[pos + len - 1] == '"') {
+      pos++;
+      len -= 2;
+    }
+
+    static constexpr size_t token_len{sizeof(BUILDER_SPACE_TOKEN) - 1};
+    auto end = pos + len;
+    size_t token;
+
+    while ((token = text.find(BUILDER_SPACE_TOKEN, pos)) < end && token + token_len <= end) {
+      m_output.append(text, pos, token - pos);
+      m_output += ' ';
+      pos = token + token_len;
+    }
+
+    m_output.append(text, pos, end - pos);
+  }
+
+  void tag_open(char tag, const string& value) {
+    m_output += "%{";
+    m_output += tag;
+    m_output += value;
+    m_output += '}';
   }
 
   void tag_close(char tag) {
-    append("%{" + string({tag}) + "-}");
+    m_output += "%{";
+    m_output += tag;
+    m_output += "-}";
   }
 
  private:
   const bar_settings m_bar;
 
   string m_output;
+  string m_labeltext;
   bool m_lazy = true;
 
-  map<syntaxtag, int> m_counters{
-      // clang-format off
-      {syntaxtag::A, 0},
-      {syntaxtag::B, 0},
-      {syntaxtag::F, 0},
-      {syntaxtag::T, 0},
-      {syntaxtag::U, 0},
-      {syntaxtag::O, 0},
-      {syntaxtag::R, 0},
-      // clang-format on
-  };
-
-  map<syntaxtag, string> m_colors{
-      // clang-format off
-      {syntaxtag::B, ""},
-      {syntaxtag::F, ""},
-      {syntaxtag::U, ""},
-      // clang-format on
-  };
+  tag_values<int> m_counters;
+  tag_values<string> m_colors;
 
   int m_fontindex = 1;
 };
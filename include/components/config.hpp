@@ -3,6 +3,7 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/property_tree/ini_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
+#include <mutex>
 
 #include "common.hpp"
 #include "components/logger.hpp"
@@ -25,7 +26,7 @@ class config {
   /**
    * Construct config
    */
-  explicit config(const logger& logger, const xresource_manager& xrm)
+  explicit config(const logger& logger, xresource_manager& xrm)
       : m_logger(logger), m_xrm(xrm) {}
 
   /**
@@ -40,12 +41,16 @@ class config {
     if (!file_util::exists(file))
       throw application_error("Could not find config file: " + file);
 
+    ptree tree;
+
     try {
-      boost::property_tree::read_ini(file, m_ptree);
+      boost::property_tree::read_ini(file, tree);
     } catch (const std::exception& e) {
       throw application_error(e.what());
     }
 
+    publish(move(tree));
+
     auto bars = defined_bars();
     if (std::find(bars.begin(), bars.end(), m_current_bar) == bars.end())
       throw application_error("Undefined bar: " + m_current_bar);
@@ -58,6 +63,62 @@ class config {
     m_logger.trace("config: Current bar section: [%s]", bar_section());
   }
 
+  /**
+   * Reload the configuration file and the X resources
+   *
+   * The current values are kept if the file can't be loaded. Values
+   * read by other threads while reloading come from either the old
+   * or the new tree, never from a mix of both.
+   *
+   * @return Keys with changed values grouped by section, references are
+   *         resolved so changes to referenced values are included
+   */
+  map<string, vector<string>> reload() {
+    ptree next;
+
+    try {
+      boost::property_tree::read_ini(m_file, next);
+    } catch (const std::exception& e) {
+      throw application_error(e.what());
+    }
+
+    if (next.find(bar_section()) == next.not_found())
+      throw application_error("Undefined bar: " + m_current_bar);
+
+    auto before = resolve_values(*tree());
+
+    m_xrm.reload();
+    publish(move(next));
+
+    auto after = resolve_values(*tree());
+    map<string, vector<string>> changes;
+
+    for (auto&& section : after) {
+      auto& previous = before[section.first];
+
+      for (auto&& value : section.second) {
+        auto it = previous.find(value.first);
+        if (it == previous.end() || it->second != value.second)
+          changes[section.first].emplace_back(value.first);
+      }
+
+      for (auto&& value : previous) {
+        if (section.second.find(value.first) == section.second.end())
+          changes[section.first].emplace_back(value.first);
+      }
+    }
+
+    for (auto&& section : before) {
+      if (after.find(section.first) == after.end() && !section.second.empty()) {
+        for (auto&& value : section.second) changes[section.first].emplace_back(value.first);
+      }
+    }
+
+    m_logger.trace("config: Reloaded %s (%lu changed sections)", m_file, changes.size());
+
+    return changes;
+  }
+
   /**
    * Get path of loaded file
    */
@@ -78,7 +139,7 @@ class config {
   vector<string> defined_bars() const {
     vector<string> bars;
 
-    for (auto&& p : m_ptree) {
+    for (auto&& p : *tree()) {
       if (p.first.compare(0, 4, "bar/") == 0)
         bars.emplace_back(p.first.substr(4));
     }
@@ -106,14 +167,15 @@ class config {
    */
   template <typename T>
   T get(string section, string key) const {
-    auto val = m_ptree.get_optional<T>(build_path(section, key));
+    auto tree = this->tree();
+    auto val = tree->get_optional<T>(build_path(section, key));
 
     if (val == boost::none)
       throw key_error("Missing parameter [" + section + "." + key + "]");
 
-    auto str_val = m_ptree.get<string>(build_path(section, key));
+    auto str_val = tree->get<string>(build_path(section, key));
 
-    return dereference_var<T>(section, key, str_val, val.get());
+    return dereference_var<T>(*tree, section, key, str_val, val.get());
   }
 
   /**
@@ -122,11 +184,12 @@ class config {
    */
   template <typename T>
   T get(string section, string key, T default_value) const {
-    auto val = m_ptree.get_optional<T>(build_path(section, key));
-    auto str_val = m_ptree.get_optional<string>(build_path(section, key));
+    auto tree = this->tree();
+    auto val = tree->get_optional<T>(build_path(section, key));
+    auto str_val = tree->get_optional<string>(build_path(section, key));
 
     return dereference_var<T>(
-        section, key, str_val.get_value_or(""), val.get_value_or(default_value));
+        *tree, section, key, str_val.get_value_or(""), val.get_value_or(default_value));
   }
 
   /**
@@ -142,13 +205,14 @@ class config {
    */
   template <typename T>
   vector<T> get_list(string section, string key) const {
+    auto tree = this->tree();
     vector<T> vec;
     optional<T> value;
 
-    while ((value = m_ptree.get_optional<T>(
+    while ((value = tree->get_optional<T>(
                 build_path(section, key) + "-" + to_string(vec.size()))) != boost::none) {
-      auto str_val = m_ptree.get<string>(build_path(section, key) + "-" + to_string(vec.size()));
-      vec.emplace_back(dereference_var<T>(section, key, str_val, value.get()));
+      auto str_val = tree->get<string>(build_path(section, key) + "-" + to_string(vec.size()));
+      vec.emplace_back(dereference_var<T>(*tree, section, key, str_val, value.get()));
     }
 
     if (vec.empty())
@@ -163,13 +227,14 @@ class config {
    */
   template <typename T>
   vector<T> get_list(string section, string key, vector<T> default_value) const {
+    auto tree = this->tree();
     vector<T> vec;
     optional<T> value;
 
-    while ((value = m_ptree.get_optional<T>(
+    while ((value = tree->get_optional<T>(
                 build_path(section, key) + "-" + to_string(vec.size()))) != boost::none) {
-      auto str_val = m_ptree.get<string>(build_path(section, key) + "-" + to_string(vec.size()));
-      vec.emplace_back(dereference_var<T>(section, key, str_val, value.get()));
+      auto str_val = tree->get<string>(build_path(section, key) + "-" + to_string(vec.size()));
+      vec.emplace_back(dereference_var<T>(*tree, section, key, str_val, value.get()));
     }
 
     if (vec.empty())
@@ -179,6 +244,48 @@ class config {
   }
 
  protected:
+  /**
+   * Get the current tree, which is never modified once published
+   * so it can be read after the lock has been released
+   */
+  shared_ptr<const ptree> tree() const {
+    std::lock_guard<std::mutex> guard(m_treelock);
+    return m_ptree;
+  }
+
+  /**
+   * Replace the current tree, readers holding the previous
+   * one keep it alive until they're done
+   */
+  void publish(ptree&& tree) {
+    auto next = make_shared<const ptree>(forward<ptree>(tree));
+    std::lock_guard<std::mutex> guard(m_treelock);
+    m_ptree.swap(next);
+  }
+
+  /**
+   * Get all values with their references resolved, grouped by section
+   */
+  map<string, map<string, string>> resolve_values(const ptree& tree) const {
+    map<string, map<string, string>> values;
+
+    for (auto&& section : tree) {
+      auto& resolved = values[section.first];
+
+      for (auto&& value : section.second) {
+        auto raw = value.second.get_value<string>();
+        try {
+          resolved[value.first] =
+              dereference_var<string>(tree, section.first, value.first, raw, raw);
+        } catch (const std::exception&) {
+          resolved[value.first] = raw;
+        }
+      }
+    }
+
+    return values;
+  }
+
   /**
    * Find value of a config parameter defined as a reference
    * variable using ${section.param} or ${env:VAR}
@@ -188,7 +295,8 @@ class config {
    * but the former is kept to avoid breaking current configs
    */
   template <typename T>
-  T dereference_var(string ref_section, string ref_key, string var, const T ref_val) const {
+  T dereference_var(const ptree& tree, string ref_section, string ref_key, string var,
+      const T ref_val) const {
     auto n = var.find("${");
     auto m = var.find("}");
 
@@ -224,20 +332,21 @@ class config {
     section = string_util::replace(section, "self", bar_section());
 
     auto key = path.substr(n + 1, path.length() - n - 1);
-    auto val = m_ptree.get_optional<T>(build_path(section, key));
+    auto val = tree.get_optional<T>(build_path(section, key));
 
     if (val == boost::none)
       throw value_error("Unexisting reference defined at [" + ref_path + "]");
 
-    auto str_val = m_ptree.get<string>(build_path(section, key));
+    auto str_val = tree.get<string>(build_path(section, key));
 
-    return dereference_var<T>(section, key, str_val, val.get());
+    return dereference_var<T>(tree, section, key, str_val, val.get());
   }
 
  private:
   const logger& m_logger;
-  const xresource_manager& m_xrm;
-  ptree m_ptree;
+  xresource_manager& m_xrm;
+  mutable std::mutex m_treelock;
+  shared_ptr<const ptree> m_ptree{make_shared<const ptree>()};
   string m_file;
   string m_current_bar;
 };
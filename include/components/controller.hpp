@@ -1,6 +1,11 @@
 #pragma once
 
+#include <sys/stat.h>
+#include <algorithm>
+#include <condition_variable>
+#include <set>
 #include <thread>
+#include <unordered_map>
 
 #include "common.hpp"
 #include "components/bar.hpp"
@@ -9,12 +14,14 @@
 #include "components/signals.hpp"
 #include "components/x11/connection.hpp"
 #include "components/x11/randr.hpp"
+#include "components/x11/screensaver.hpp"
 #include "components/x11/tray.hpp"
 #include "components/x11/types.hpp"
 #include "config.hpp"
 #include "utils/command.hpp"
 #include "utils/inotify.hpp"
 #include "utils/process.hpp"
+#include "utils/snapshot.hpp"
 #include "utils/socket.hpp"
 #include "utils/throttle.hpp"
 
@@ -48,12 +55,41 @@ LEMONBUDDY_NS
 using namespace modules;
 using module_t = unique_ptr<module_interface>;
 
+enum class update_priority { LOW, NORMAL, HIGH };
+
+/**
+ * Scheduling state of a module's updates
+ */
+struct update_budget {
+  update_priority priority{update_priority::NORMAL};
+  unique_ptr<throttle_util::token_bucket> bucket;
+  bool pending{false};
+  size_t deferred{0};
+  size_t merged{0};
+};
+
+/**
+ * Bar window on an additional output
+ *
+ * The modules are shared with the primary bar, except for the
+ * ones that show per-monitor state, which get their own instance
+ */
+struct bar_output {
+  unique_ptr<bar> window;
+  map<string, module_t> modules;
+};
+
+/**
+ * Composed input of each bar window, the primary bar comes first
+ */
+using frame_t = vector<std::pair<bar*, string>>;
+
 class controller {
  public:
   /**
    * Construct controller
    */
-  explicit controller(connection& conn, const logger& logger, const config& config,
+  explicit controller(connection& conn, const logger& logger, config& config,
       unique_ptr<bar> bar, unique_ptr<traymanager> tray, inotify_watch_t& confwatch)
       : m_connection(conn)
       , m_log(logger)
@@ -67,6 +103,11 @@ class controller {
    * threads and spawned processes
    */
   ~controller() noexcept {
+    // Their callbacks need the lock, so stop them before taking it
+    m_screensaver.reset();
+    g_signals::bar::output_change = nullptr;
+    m_outputwatch.reset();
+
     if (!m_mutex.try_lock_for(5s)) {
       m_log.warn("Failed to acquire lock for 5s... Forcing shutdown using SIGKILL");
       raise(SIGKILL);
@@ -74,12 +115,12 @@ class controller {
 
     std::lock_guard<std::timed_mutex> guard(m_mutex, std::adopt_lock);
 
+    save_snapshot();
+
     m_log.trace("controller: Stop modules");
-    for (auto&& block : m_modules) {
-      for (auto&& module : block.second) {
-        module->stop();
-      }
-    }
+    for (auto&& module : all_modules()) module->stop();
+
+    for (auto&& budget : m_budgets) log_budget(budget.first, budget.second);
 
     if (m_traymanager) {
       m_log.trace("controller: Deactivate tray manager");
@@ -89,7 +130,14 @@ class controller {
 
     m_log.trace("controller: Deconstruct bar instance");
     g_signals::bar::action_click = nullptr;
-    m_bar.reset();
+    g_signals::bar::xresources_change = nullptr;
+    g_signals::bar::obscured_change = nullptr;
+    m_frames.close();
+    {
+      std::lock_guard<std::mutex> renderguard(m_rendermtx);
+      m_outputs.clear();
+      m_bar.reset();
+    }
 
     m_log.trace("controller: Interrupt X event loop");
     m_connection.send_dummy_event(m_connection.root());
@@ -102,6 +150,13 @@ class controller {
       }
     }
 
+    m_flushcond.notify_all();
+
+    {
+      std::lock_guard<std::mutex> lck(m_snapshotmtx);
+    }
+    m_snapshotcond.notify_all();
+
     if (!m_threads.empty()) {
       m_log.trace("controller: Join active threads");
       for (auto&& thread : m_threads) {
@@ -141,14 +196,19 @@ class controller {
     m_log.trace("controller: Found 'RandR' (first_event: %i, first_error: %i)",
         randr_ext->first_event, randr_ext->first_error);
 
-    // Listen for events on the root window to be able to
-    // break the blocking wait call when cleaning up
+    // The RandR request is not checked since failing to follow
+    // output changes is not fatal, which saves a round-trip
     m_log.trace("controller: Listen for events on the root window");
+    m_connection.select_input(m_connection.root(), XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE |
+                                                       XCB_RANDR_NOTIFY_MASK_CRTC_CHANGE |
+                                                       XCB_RANDR_NOTIFY_MASK_OUTPUT_CHANGE);
 
     try {
-      const uint32_t value_list[1]{XCB_EVENT_MASK_STRUCTURE_NOTIFY};
+      const uint32_t value_list[1]{
+          XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE};
       m_connection.change_window_attributes_checked(
           m_connection.root(), XCB_CW_EVENT_MASK, value_list);
+      m_connection.count_roundtrip();
     } catch (const std::exception& err) {
       throw application_error("Failed to change root window event mask: " + string{err.what()});
     }
@@ -160,7 +220,17 @@ class controller {
         std::cout << m_bar->settings().wmname << std::endl;
         return;
       } else if (!to_stdout) {
-        g_signals::bar::action_click = bind(&controller::on_module_click, this, std::placeholders::_1);
+        g_signals::bar::action_click = bind(
+            &controller::on_module_click, this, std::placeholders::_1, std::placeholders::_2);
+        g_signals::bar::xresources_change = bind(&controller::on_xresources_change, this);
+
+        if (m_conf.get<bool>("settings", "suspend-when-hidden", true)) {
+          g_signals::bar::obscured_change =
+              bind(&controller::on_obscured_change, this, std::placeholders::_1);
+          m_screensaver = make_unique<screensaver_watch>(m_log);
+        }
+
+        bootstrap_outputs();
       }
     } catch (const std::exception& err) {
       throw application_error("Failed to setup bar renderer: " + string{err.what()});
@@ -186,11 +256,30 @@ class controller {
     m_log.trace("main: Setup bar modules");
     bootstrap_modules();
 
+    // Save the module output every <snapshot-interval> seconds, 0 disables snapshots
+    m_snapshot_interval =
+        chrono::seconds{m_conf.get<unsigned int>("settings", "snapshot-interval", 60)};
+
+    if (m_snapshot_interval.count() > 0) {
+      m_snapshot_path = snapshot_util::path(m_conf.bar_section().substr(4));
+      restore_snapshot();
+    }
+
+    // Wait at most <startup-timeout> ms for the initial module output, unless
+    // the module sets its own limit using <setup-timeout>
+    const auto startup_timeout = m_conf.get<unsigned int>("settings", "startup-timeout", 250);
+
+    for (auto&& module : all_modules()) {
+      m_setup_timeouts[module->name()] = chrono::milliseconds{
+          m_conf.get<unsigned int>(module->name(), "setup-timeout", startup_timeout)};
+    }
+
     // Allow <throttle_limit>  ticks within <throttle_ms> timeframe
     const auto throttle_limit = m_conf.get<unsigned int>("settings", "throttle-limit", 3);
     const auto throttle_ms = chrono::duration<double, std::milli>(
         m_conf.get<unsigned int>("settings", "throttle-ms", 60));
     m_throttler = throttle_util::make_throttler(throttle_limit, throttle_ms);
+    m_flush_interval = chrono::duration_cast<chrono::milliseconds>(throttle_ms);
   }
 
   /**
@@ -203,25 +292,24 @@ class controller {
     m_running = true;
 
     install_sigmask();
+    install_runner();
+    install_outputwatch();
     install_confwatch();
+    install_flusher();
+    install_renderer();
+    install_snapshots();
 
     m_threads.emplace_back([this] {
       m_connection.flush();
 
       m_log.trace("controller: Start modules");
-      for (auto&& block : m_modules) {
-        for (auto&& module : block.second) {
-          try {
-            module->start();
-          } catch (const application_error& err) {
-            m_log.err("Failed to start '%s' (reason: %s)", module->name(), err.what());
-          }
-
-          // Offset the initial broadcasts by 25ms to
-          // avoid the updates from being ignored by the throttler
-          this_thread::sleep_for(25ms);
-        }
+      {
+        std::lock_guard<std::timed_mutex> guard(m_mutex);
+        m_startup_begin = chrono::steady_clock::now();
       }
+      for (auto&& module : all_modules()) start_module(module);
+
+      wait_for_modules();
 
       if (m_stdout) {
         m_log.trace("controller: Ignoring tray manager (reason: stdout mode)");
@@ -229,6 +317,15 @@ class controller {
         return;
       }
 
+      if (m_screensaver) {
+        try {
+          m_log.trace("controller: Start screensaver watch");
+          m_screensaver->start(bind(&controller::on_display_change, this, std::placeholders::_1));
+        } catch (const std::exception& err) {
+          m_log.warn("Failed to watch the screensaver state (%s)", err.what());
+        }
+      }
+
       if (m_traymanager) {
         try {
           m_log.trace("controller: Activate tray manager");
@@ -242,15 +339,16 @@ class controller {
       m_connection.flush();
 
       m_log.trace("controller: Listen for X events");
-      while (m_running) {
-        auto evt = m_connection.wait_for_event();
-        if (evt != nullptr && m_running)
-          m_connection.dispatch_event(evt);
-      }
+      process_xevents();
     });
 
     wait();
 
+    // Apply configuration changes in place for as long as possible
+    while (m_reload && reload()) {
+      wait();
+    }
+
     m_running = false;
 
     return !m_reload;
@@ -265,10 +363,14 @@ class controller {
     int caught_signal = 0;
     sigwait(&m_waitmask, &caught_signal);
 
-    m_log.warn("Termination signal received, shutting down...");
-    m_log.trace("controller: Caught signal %d", caught_signal);
-
     m_reload = (caught_signal == SIGUSR1);
+    m_confchanged = false;
+
+    if (m_reload)
+      m_log.info("Reload signal received...");
+    else
+      m_log.warn("Termination signal received, shutting down...");
+    m_log.trace("controller: Caught signal %d", caught_signal);
   }
 
  protected:
@@ -291,6 +393,36 @@ class controller {
       throw system_error();
   }
 
+  /**
+   * Start the thread that spawns click commands, it's created after
+   * the sigmask has been set so that it inherits the blocked signals
+   */
+  void install_runner() {
+    if (!m_running)
+      return;
+
+    // Allow <click-limit> instances of the same shell command to run at once
+    const auto click_limit = m_conf.get<size_t>("settings", "click-limit", 1);
+    const auto click_repeat = m_conf.get<string>("settings", "click-repeat", "drop") == "queue"
+                                  ? command_util::repeat_policy::QUEUE
+                                  : command_util::repeat_policy::DROP;
+    m_runner = command_util::make_runner(click_limit, click_repeat);
+  }
+
+  /**
+   * Follow display changes, the debouncer thread is created after
+   * the sigmask has been set so that it inherits the blocked signals
+   */
+  void install_outputwatch() {
+    if (!m_running || m_stdout)
+      return;
+
+    // A display change is announced by a burst of notifications
+    m_outputwatch =
+        make_unique<throttle_util::debouncer>(200ms, bind(&controller::on_output_change, this));
+    g_signals::bar::output_change = bind(&throttle_util::debouncer::trigger, m_outputwatch.get());
+  }
+
   /**
    * Listen for changes to the config file
    */
@@ -303,28 +435,242 @@ class controller {
       return;
     }
 
+    try {
+      // The shared inotify service attaches the watch again if an editor replaces the file
+      m_log.trace("controller: Attach config watch");
+      m_confwatch->attach(IN_MODIFY, [this](const inotify_event&) {
+        if (!m_running || m_confchanged.exchange(true))
+          return;
+        m_log.info("Configuration file changed...");
+        kill(getpid(), SIGUSR1);
+      });
+    } catch (const system_error& err) {
+      m_log.err(err.what());
+      m_log.trace("controller: Reset config watch");
+      m_confwatch.reset();
+    }
+  }
+
+  /**
+   * Draw the updates that were deferred by the update budgets
+   *
+   * Deferred updates are collected for one throttle window
+   * and then drawn together in a single frame
+   */
+  void install_flusher() {
+    if (!m_running)
+      return;
+
     m_threads.emplace_back([this] {
-      this_thread::sleep_for(1s);
+      std::unique_lock<std::mutex> lck(m_flushmtx);
+
+      while (m_running) {
+        m_flushcond.wait(lck, [this] { return m_deferred || !m_running; });
 
-      try {
         if (!m_running)
-          return;
+          break;
+
+        lck.unlock();
+        this_thread::sleep_for(m_flush_interval);
+        m_deferred = false;
+        on_module_update("");
+        lck.lock();
+      }
+    });
+  }
 
-        m_log.trace("controller: Attach config watch");
-        m_confwatch->attach(IN_MODIFY);
+  /**
+   * Create a bar window for each additional output matched by
+   * the monitor setting, the first one is used by the primary bar
+   */
+  void bootstrap_outputs() {
+    auto monitors = randr_util::get_monitors(m_connection, m_connection.root());
+    auto pattern = m_conf.get<string>(m_conf.bar_section(), "monitor", "");
+    auto names = randr_util::match_monitors(monitors, pattern);
+
+    for (auto&& name : names) {
+      if (name != m_bar->settings().monitor->name)
+        create_output(name);
+    }
+  }
+
+  /**
+   * Create the bar window for an additional output
+   *
+   * @return false if the bar could not be created
+   */
+  bool create_output(const string& name) {
+    try {
+      m_log.trace("controller: Setup bar renderer for output %s", name);
+      bar_output output;
+      output.window = configure_bar().create<unique_ptr<bar>>();
+      output.window->bootstrap(false, name, false);
+      m_outputs.emplace_back(move(output));
+      return true;
+    } catch (const std::exception& err) {
+      m_log.err("Failed to setup bar on output %s (%s)", name, err.what());
+      return false;
+    }
+  }
 
-        m_log.trace("controller: Wait for config file inotify event");
-        m_confwatch->get_event();
+  /**
+   * Create the per-monitor module instances of an additional output
+   */
+  void create_output_modules(bar_output& output) {
+    for (auto&& align : {alignment::LEFT, alignment::CENTER, alignment::RIGHT}) {
+      for (auto& module_name : module_names(align)) {
+        auto section = "module/" + module_name;
+        if (per_monitor(section) && output.modules.find(section) == output.modules.end())
+          output.modules.emplace(section, create_module(module_name, output.window->settings()));
+      }
+    }
+  }
 
+  /**
+   * Handle X events until the event loop is interrupted
+   *
+   * All events that are available are read before acting on them.
+   * Superseded events of a batch are dropped and the connection is
+   * flushed once per batch, so that a burst of events only causes
+   * a single redraw.
+   */
+  void process_xevents() {
+    while (m_running) {
+      auto events = m_connection.wait_for_events();
+
+      if (events.empty()) {
         if (!m_running)
           return;
+        m_log.err("X connection error, shutting down...");
+        kill(getpid(), SIGTERM);
+        return;
+      }
 
-        m_log.info("Configuration file changed...");
-        kill(getpid(), SIGUSR1);
-      } catch (const system_error& err) {
-        m_log.err(err.what());
-        m_log.trace("controller: Reset config watch");
-        m_confwatch.reset();
+      xutils::coalesce_events(events);
+
+      for (auto&& evt : events) {
+        if (!m_running)
+          return;
+        m_connection.dispatch_event(evt);
+      }
+
+      m_connection.flush();
+    }
+  }
+
+  /**
+   * Periodically save the module output
+   */
+  void install_snapshots() {
+    if (!m_running || m_snapshot_path.empty())
+      return;
+
+    m_threads.emplace_back([this] {
+      std::unique_lock<std::mutex> lck(m_snapshotmtx);
+
+      while (m_running) {
+        m_snapshotcond.wait_for(lck, m_snapshot_interval, [this] { return !m_running; });
+
+        if (!m_running)
+          break;
+
+        lck.unlock();
+
+        // Skip this round rather than block the shutdown
+        if (m_mutex.try_lock_for(50ms)) {
+          std::lock_guard<std::timed_mutex> guard(m_mutex, std::adopt_lock);
+          save_snapshot();
+        }
+
+        lck.lock();
+      }
+    });
+  }
+
+  /**
+   * Identifies the configuration that a snapshot belongs to
+   *
+   * Includes the modification time of the config file, so that
+   * output of outdated module definitions is never restored.
+   * Taken whenever the modules are created from the config.
+   */
+  string snapshot_key() const {
+    struct stat info {};
+    stat(m_conf.filepath().c_str(), &info);
+    return m_conf.filepath() + "\n" + m_conf.bar_section() + "\n" + to_string(info.st_mtime);
+  }
+
+  /**
+   * Show the output of the previous run until the modules produce their own
+   */
+  void restore_snapshot() {
+    m_snapshot_key = snapshot_key();
+    auto outputs = snapshot_util::load(m_snapshot_path, m_snapshot_key);
+
+    if (outputs.empty())
+      return;
+
+    size_t restored = 0;
+
+    for (auto&& block : m_modules) {
+      for (auto&& module : block.second) {
+        auto output = outputs.find(module->name());
+        if (output == outputs.end() || output->second.empty())
+          continue;
+        module->restore(output->second);
+        restored++;
+      }
+    }
+
+    m_log.trace("controller: Restored output of %lu modules from %s", restored, m_snapshot_path);
+  }
+
+  /**
+   * Save the output of the modules of the primary bar
+   */
+  void save_snapshot() {
+    if (m_snapshot_path.empty())
+      return;
+
+    map<string, string> outputs;
+
+    for (auto&& block : m_modules) {
+      for (auto&& module : block.second) {
+        if (module->ready())
+          outputs.emplace(module->name(), *module->contents());
+      }
+    }
+
+    auto data = snapshot_util::serialize(m_snapshot_key, outputs);
+
+    if (data == m_snapshot)
+      return;
+
+    if (snapshot_util::save(m_snapshot_path, data)) {
+      m_log.trace("controller: Saved snapshot to %s", m_snapshot_path);
+      m_snapshot = move(data);
+    } else {
+      m_log.warn("Failed to save snapshot to %s", m_snapshot_path);
+    }
+  }
+
+  /**
+   * Draw the composed frames on a thread of its own
+   *
+   * Composing the next frame only waits for the module output, so
+   * it overlaps with drawing the current one. Frames that were not
+   * picked up before a newer one arrived are dropped.
+   */
+  void install_renderer() {
+    if (!m_running)
+      return;
+
+    m_threads.emplace_back([this] {
+      frame_t frame;
+
+      while (m_frames.take(frame)) {
+        std::lock_guard<std::mutex> guard(m_rendermtx);
+        render(frame);
       }
     });
   }
@@ -333,111 +679,633 @@ class controller {
    * Create and initialize bar modules
    */
   void bootstrap_modules() {
-    m_modules.emplace(alignment::LEFT, vector<module_t>{});
-    m_modules.emplace(alignment::CENTER, vector<module_t>{});
-    m_modules.emplace(alignment::RIGHT, vector<module_t>{});
-
     size_t module_count = 0;
 
-    for (auto& block : m_modules) {
-      string bs{m_conf.bar_section()};
-      string confkey;
+    for (auto&& align : {alignment::LEFT, alignment::CENTER, alignment::RIGHT}) {
+      auto& modules = m_modules[align];
 
-      switch (block.first) {
-        case alignment::LEFT:
-          confkey = "modules-left";
-          break;
-        case alignment::CENTER:
-          confkey = "modules-center";
-          break;
-        case alignment::RIGHT:
-          confkey = "modules-right";
-          break;
-        default:
+      for (auto& module_name : module_names(align)) {
+        modules.emplace_back(create_module(module_name));
+        module_count++;
+      }
+    }
+
+    if (module_count == 0)
+      throw application_error("No modules created");
+
+    for (auto&& output : m_outputs) create_output_modules(output);
+
+    index_events();
+  }
+
+  /**
+   * Check if the module shows state that depends on the output it is drawn on
+   */
+  bool per_monitor(const string& section) const {
+    auto type = m_conf.get<string>(section, "type");
+    return type == "internal/i3" || type == "internal/bspwm" || type == "internal/xbacklight";
+  }
+
+  /**
+   * Get all module instances, including those of the additional outputs
+   */
+  vector<module_interface*> all_modules() const {
+    vector<module_interface*> modules;
+
+    for (auto&& block : m_modules) {
+      for (auto&& module : block.second) modules.emplace_back(module.get());
+    }
+    for (auto&& output : m_outputs) {
+      for (auto&& module : output.modules) modules.emplace_back(module.second.get());
+    }
+
+    return modules;
+  }
+
+  /**
+   * Get the names of the modules defined for the given block
+   */
+  vector<string> module_names(alignment align) const {
+    string confkey;
+
+    switch (align) {
+      case alignment::LEFT:
+        confkey = "modules-left";
+        break;
+      case alignment::CENTER:
+        confkey = "modules-center";
+        break;
+      case alignment::RIGHT:
+        confkey = "modules-right";
+        break;
+      default:
+        return {};
+    }
+
+    return string_util::split(m_conf.get<string>(m_conf.bar_section(), confkey, ""), ' ');
+  }
+
+  /**
+   * Create module instance for the primary bar
+   */
+  module_t create_module(string module_name) {
+    return create_module(module_name, m_bar->settings());
+  }
+
+  /**
+   * Create module instance
+   */
+  module_t create_module(string module_name, const bar_settings& bar) {
+    auto type = m_conf.get<string>("module/" + module_name, "type");
+    module_t module;
+
+    if (type == "internal/counter")
+      module.reset(new counter_module(bar, m_log, m_conf, module_name));
+    else if (type == "internal/backlight")
+      module.reset(new backlight_module(bar, m_log, m_conf, module_name));
+    else if (type == "internal/xbacklight")
+      module.reset(new xbacklight_module(bar, m_log, m_conf, module_name));
+    else if (type == "internal/battery")
+      module.reset(new battery_module(bar, m_log, m_conf, module_name));
+    else if (type == "internal/bspwm")
+      module.reset(new bspwm_module(bar, m_log, m_conf, module_name));
+    else if (type == "internal/cpu")
+      module.reset(new cpu_module(bar, m_log, m_conf, module_name));
+    else if (type == "internal/date")
+      module.reset(new date_module(bar, m_log, m_conf, module_name));
+    else if (type == "internal/memory")
+      module.reset(new memory_module(bar, m_log, m_conf, module_name));
+    else if (type == "internal/i3")
+      module.reset(new i3_module(bar, m_log, m_conf, module_name));
+    else if (type == "internal/mpd")
+      module.reset(new mpd_module(bar, m_log, m_conf, module_name));
+    else if (type == "internal/volume")
+      module.reset(new volume_module(bar, m_log, m_conf, module_name));
+    else if (type == "internal/network")
+      module.reset(new network_module(bar, m_log, m_conf, module_name));
+    else if (type == "custom/text")
+      module.reset(new text_module(bar, m_log, m_conf, module_name));
+    else if (type == "custom/script")
+      module.reset(new script_module(bar, m_log, m_conf, module_name));
+    else if (type == "custom/menu")
+      module.reset(new menu_module(bar, m_log, m_conf, module_name));
+    else
+      throw application_error("Unknown module: " + module_name);
+
+    module->set_writer(bind(&controller::on_module_update, this, std::placeholders::_1));
+    module->set_terminator(bind(&controller::on_module_stop, this, std::placeholders::_1));
+
+    return module;
+  }
+
+  /**
+   * Start module, modules perform their setup in their own threads
+   */
+  void start_module(module_interface* module) {
+    try {
+      module->start();
+    } catch (const application_error& err) {
+      m_log.err("Failed to start '%s' (reason: %s)", module->name(), err.what());
+    }
+
+    if (m_suspended)
+      module->suspend(true);
+  }
+
+  /**
+   * Get the time left for the module to produce its initial output,
+   * modules created after startup don't hold back the first frame
+   */
+  chrono::milliseconds setup_timeout(const module_interface* module) const {
+    auto timeout = m_setup_timeouts.find(module->name());
+    return timeout != m_setup_timeouts.end() ? timeout->second : chrono::milliseconds{0};
+  }
+
+  /**
+   * Check if all running modules have produced their initial output
+   * or have run out of time for their setup
+   */
+  bool modules_ready() const {
+    auto now = chrono::steady_clock::now();
+
+    for (auto&& module : all_modules()) {
+      if (!module->ready() && m_startup_begin + setup_timeout(module) > now)
+        return false;
+    }
+    return true;
+  }
+
+  /**
+   * Get the earliest setup deadline of the modules that are not ready
+   */
+  chrono::steady_clock::time_point next_setup_deadline() const {
+    auto deadline = chrono::steady_clock::time_point::max();
+
+    for (auto&& module : all_modules()) {
+      if (!module->ready())
+        deadline = std::min(deadline, m_startup_begin + setup_timeout(module));
+    }
+    return deadline;
+  }
+
+  /**
+   * Hold back the first frame until each module has produced its
+   * initial output or its setup timeout has expired
+   *
+   * Modules that are still busy with their setup will show
+   * their placeholder until they broadcast
+   */
+  void wait_for_modules() {
+    while (!m_modules_ready) {
+      chrono::steady_clock::time_point deadline;
+      {
+        std::lock_guard<std::timed_mutex> guard(m_mutex);
+        if (modules_ready())
           break;
+        deadline = next_setup_deadline();
       }
 
-      for (auto& module_name : string_util::split(m_conf.get<string>(bs, confkey, ""), ' ')) {
-        auto type = m_conf.get<string>("module/" + module_name, "type");
-        auto bar = m_bar->settings();
-        auto& modules = block.second;
-
-        if (type == "internal/counter")
-          modules.emplace_back(new counter_module(bar, m_log, m_conf, module_name));
-        else if (type == "internal/backlight")
-          modules.emplace_back(new backlight_module(bar, m_log, m_conf, module_name));
-        else if (type == "internal/xbacklight")
-          modules.emplace_back(new xbacklight_module(bar, m_log, m_conf, module_name));
-        else if (type == "internal/battery")
-          modules.emplace_back(new battery_module(bar, m_log, m_conf, module_name));
-        else if (type == "internal/bspwm")
-          modules.emplace_back(new bspwm_module(bar, m_log, m_conf, module_name));
-        else if (type == "internal/cpu")
-          modules.emplace_back(new cpu_module(bar, m_log, m_conf, module_name));
-        else if (type == "internal/date")
-          modules.emplace_back(new date_module(bar, m_log, m_conf, module_name));
-        else if (type == "internal/memory")
-          modules.emplace_back(new memory_module(bar, m_log, m_conf, module_name));
-        else if (type == "internal/i3")
-          modules.emplace_back(new i3_module(bar, m_log, m_conf, module_name));
-        else if (type == "internal/mpd")
-          modules.emplace_back(new mpd_module(bar, m_log, m_conf, module_name));
-        else if (type == "internal/volume")
-          modules.emplace_back(new volume_module(bar, m_log, m_conf, module_name));
-        else if (type == "internal/network")
-          modules.emplace_back(new network_module(bar, m_log, m_conf, module_name));
-        else if (type == "custom/text")
-          modules.emplace_back(new text_module(bar, m_log, m_conf, module_name));
-        else if (type == "custom/script")
-          modules.emplace_back(new script_module(bar, m_log, m_conf, module_name));
-        else if (type == "custom/menu")
-          modules.emplace_back(new menu_module(bar, m_log, m_conf, module_name));
+      std::unique_lock<std::mutex> lck(m_readymtx);
+      m_readycond.wait_until(lck, deadline, [this] { return m_modules_ready.load(); });
+    }
+
+    {
+      std::lock_guard<std::timed_mutex> guard(m_mutex);
+
+      for (auto&& module : all_modules()) {
+        if (!module->ready())
+          m_log.warn("%s: Not ready after %lims, showing placeholder", module->name(),
+              setup_timeout(module).count());
+      }
+    }
+
+    m_log.info("controller: Draw initial frame (%lu X round-trips during startup)",
+        m_connection.roundtrips());
+    m_modules_ready = true;
+    m_startup = false;
+    on_module_update("");
+  }
+
+  /**
+   * Map the command prefixes claimed by the modules to their handlers
+   */
+  void index_events() {
+    m_eventhandlers.clear();
+    m_eventprefixlens.clear();
+
+    m_eventoutputs.clear();
+
+    map<string, update_budget> budgets;
+
+    for (auto&& module : all_modules()) {
+      // Instances of the same module share their budget
+      if (budgets.find(module->name()) == budgets.end()) {
+        auto budget = m_budgets.find(module->name());
+        if (budget != m_budgets.end())
+          budgets.emplace(module->name(), move(budget->second));
         else
-          throw application_error("Unknown module: " + module_name);
+          budgets.emplace(module->name(), create_budget(module->name()));
+      }
 
-        auto& module = modules.back();
+      for (auto&& prefix : module->event_prefixes()) {
+        m_eventhandlers[prefix].emplace_back(module);
+        m_eventprefixlens.emplace_back(prefix.length());
+      }
+    }
 
-        module->set_writer(bind(&controller::on_module_update, this, std::placeholders::_1));
-        module->set_terminator(bind(&controller::on_module_stop, this, std::placeholders::_1));
+    // Per-monitor modules only receive the clicks made on their own output
+    if (!m_outputs.empty()) {
+      for (auto&& block : m_modules) {
+        for (auto&& module : block.second) {
+          if (per_monitor(module->name()))
+            m_eventoutputs[module.get()] = m_bar->settings().monitor->name;
+        }
+      }
+      for (auto&& output : m_outputs) {
+        for (auto&& module : output.modules)
+          m_eventoutputs[module.second.get()] = output.window->settings().monitor->name;
+      }
+    }
 
-        module_count++;
+    m_budgets.swap(budgets);
+
+    // Match against longer prefixes first
+    std::sort(m_eventprefixlens.begin(), m_eventprefixlens.end(), std::greater<size_t>());
+    m_eventprefixlens.erase(
+        std::unique(m_eventprefixlens.begin(), m_eventprefixlens.end()), m_eventprefixlens.end());
+  }
+
+  /**
+   * Read the update priority and rate limit of a module
+   *
+   * Workspace and volume indicators are drawn without delay by default,
+   * while script and network output may be deferred
+   */
+  update_budget create_budget(const string& section) const {
+    update_budget budget;
+
+    auto type = m_conf.get<string>(section, "type");
+    string priority{"normal"};
+
+    if (type == "internal/bspwm" || type == "internal/i3" || type == "internal/volume" ||
+        type == "internal/backlight" || type == "internal/xbacklight")
+      priority = "high";
+    else if (type == "custom/script" || type == "internal/network")
+      priority = "low";
+
+    priority = m_conf.get<string>(section, "priority", priority);
+
+    if (priority == "high")
+      budget.priority = update_priority::HIGH;
+    else if (priority == "low")
+      budget.priority = update_priority::LOW;
+    else if (priority != "normal")
+      m_log.warn("%s: Unknown priority '%s', using 'normal'", section, priority);
+
+    auto rate = m_conf.get<double>(section, "max-rate", 0.0);
+    auto burst = m_conf.get<double>(section, "max-burst", rate);
+
+    if (rate > 0.0)
+      budget.bucket = make_unique<throttle_util::token_bucket>(rate, burst);
+
+    return budget;
+  }
+
+  /**
+   * Report how many updates of a module were held back
+   */
+  void log_budget(const string& module_name, const update_budget& budget) const {
+    if (budget.deferred > 0 || budget.merged > 0)
+      m_log.info("%s: %lu updates deferred, %lu merged", module_name, budget.deferred,
+          budget.merged);
+  }
+
+  /**
+   * Apply changes to the configuration without recreating the bar
+   *
+   * Only the modules whose sections changed are recreated. Changes
+   * to any other bar settings or to the application settings
+   * require a full restart.
+   *
+   * @return false if a full restart is required
+   */
+  bool reload() {
+    if (m_restart)
+      return false;
+
+    map<string, vector<string>> changes;
+
+    try {
+      changes = m_conf.reload();
+    } catch (const application_error& err) {
+      m_log.err("Failed to reload configuration, keeping current settings (%s)", err.what());
+      return true;
+    }
+
+    std::set<string> changed_modules;
+
+    for (auto&& section : changes) {
+      if (section.first.compare(0, 7, "module/") == 0) {
+        changed_modules.emplace(section.first);
+        continue;
+      } else if (section.first != m_conf.bar_section()) {
+        // Values referenced from other sections are part of the resolved changes
+        continue;
+      }
+
+      for (auto&& key : section.second) {
+        if (key.compare(0, 8, "modules-") != 0) {
+          m_log.info("Bar setting '%s' changed, restarting...", key);
+          return false;
+        }
       }
     }
 
-    if (module_count == 0)
-      throw application_error("No modules created");
+    if (changes.find("settings") != changes.end()) {
+      m_log.info("Application settings changed, restarting...");
+      return false;
+    }
+
+    // Create the modules that can't be reused before touching the current ones
+    map<string, size_t> reusable;
+    map<alignment, vector<string>> layout;
+    vector<module_t> created;
+    vector<map<string, module_t>> created_outputs(m_outputs.size());
+    std::set<string> sections;
+
+    for (auto&& block : m_modules) {
+      for (auto&& module : block.second) {
+        if (changed_modules.find(module->name()) == changed_modules.end())
+          reusable[module->name()]++;
+      }
+    }
+
+    try {
+      for (auto&& align : {alignment::LEFT, alignment::CENTER, alignment::RIGHT}) {
+        for (auto&& module_name : (layout[align] = module_names(align))) {
+          auto& available = reusable["module/" + module_name];
+          if (available > 0)
+            available--;
+          else
+            created.emplace_back(create_module(module_name));
+          sections.emplace("module/" + module_name);
+        }
+      }
+
+      for (size_t i = 0; i < m_outputs.size(); i++) {
+        auto& output = m_outputs[i];
+
+        for (auto&& section : sections) {
+          if (!per_monitor(section))
+            continue;
+          if (output.modules.find(section) != output.modules.end() &&
+              changed_modules.find(section) == changed_modules.end())
+            continue;
+          created_outputs[i].emplace(
+              section, create_module(section.substr(7), output.window->settings()));
+        }
+      }
+    } catch (const std::exception& err) {
+      m_log.err("Failed to create module, restarting... (%s)", err.what());
+      return false;
+    }
+
+    if (layout[alignment::LEFT].empty() && layout[alignment::CENTER].empty() &&
+        layout[alignment::RIGHT].empty())
+      return false;
+
+    vector<module_t> removed;
+    vector<module_interface*> started;
+
+    {
+      std::lock_guard<std::timed_mutex> guard(m_mutex);
+      std::lock_guard<std::mutex> clickguard(m_clickmtx);
+
+      map<string, vector<module_t>> previous;
+
+      for (auto&& block : m_modules) {
+        for (auto&& module : block.second) {
+          if (changed_modules.find(module->name()) == changed_modules.end())
+            previous[module->name()].emplace_back(move(module));
+          else
+            removed.emplace_back(move(module));
+        }
+        block.second.clear();
+      }
+
+      auto next = created.begin();
+
+      for (auto&& block : layout) {
+        for (auto&& module_name : block.second) {
+          auto& candidates = previous["module/" + module_name];
+
+          if (!candidates.empty()) {
+            m_modules[block.first].emplace_back(move(candidates.front()));
+            candidates.erase(candidates.begin());
+          } else {
+            started.emplace_back(next->get());
+            m_modules[block.first].emplace_back(move(*next++));
+          }
+        }
+      }
+
+      for (auto&& unused : previous) {
+        for (auto&& module : unused.second) removed.emplace_back(move(module));
+      }
+
+      for (size_t i = 0; i < m_outputs.size(); i++) {
+        auto& modules = created_outputs[i];
+
+        for (auto&& module : modules) started.emplace_back(module.second.get());
+
+        for (auto&& module : m_outputs[i].modules) {
+          if (modules.find(module.first) == modules.end() &&
+              sections.find(module.first) != sections.end() &&
+              changed_modules.find(module.first) == changed_modules.end())
+            modules.emplace(module.first, move(module.second));
+          else
+            removed.emplace_back(move(module.second));
+        }
+
+        m_outputs[i].modules.swap(modules);
+      }
+
+      for (auto&& module_name : changed_modules) {
+        auto budget = m_budgets.find(module_name);
+        if (budget == m_budgets.end())
+          continue;
+        log_budget(module_name, budget->second);
+        m_budgets.erase(budget);
+      }
+
+      index_events();
+    }
+
+    m_log.info("Reloaded configuration (%lu modules started, %lu removed)", started.size(),
+        removed.size());
+
+    {
+      std::lock_guard<std::timed_mutex> guard(m_mutex);
+      m_snapshot_key = snapshot_key();
+
+      // The bar is kept, so pick up images that were changed on disk
+      m_bar->reload_images();
+      for (auto&& output : m_outputs) output.window->reload_images();
+    }
+
+    for (auto&& module : started) start_module(module);
+
+    // Stop the modules before destroying them, their threads still use
+    // the parts of the module that are gone once ~module() runs
+    for (auto&& module : removed) module->stop();
+    removed.clear();
+
+    on_module_update("");
+
+    return true;
   }
 
-  void on_module_update(string /* module_name */) {
+  /**
+   * Compose the output of all modules and pass it on to the render thread
+   *
+   * Updates that exceed the budget of their module, or that
+   * are throttled, are deferred and drawn by the flusher
+   */
+  void on_module_update(string module_name) {
     if (!m_mutex.try_lock_for(50ms)) {
       this_thread::yield();
+      defer_update();
       return;
     }
     std::lock_guard<std::timed_mutex> guard(m_mutex, std::adopt_lock);
 
     if (!m_running)
       return;
-    if (!m_throttler->passthrough(m_throttle_strategy)) {
+
+    if (m_suspended) {
+      // The modules keep their latest output until the bar is visible again
+      return;
+    } else if (m_resuming) {
+      // Wait for the fresh frame drawn by the flusher
+      if (!module_name.empty())
+        return;
+      m_resuming = false;
+    }
+
+    if (m_startup) {
+      // Skip partial frames until all modules are ready
+      if (!m_modules_ready && modules_ready()) {
+        {
+          std::lock_guard<std::mutex> lck(m_readymtx);
+          m_modules_ready = true;
+        }
+        m_readycond.notify_all();
+      }
+      return;
+    }
+
+    auto budget = m_budgets.find(module_name);
+    auto priority = update_priority::NORMAL;
+
+    if (budget != m_budgets.end()) {
+      priority = budget->second.priority;
+
+      if (budget->second.pending) {
+        // Already waiting for the next frame
+        budget->second.merged++;
+        return;
+      } else if (priority == update_priority::LOW ||
+                 (budget->second.bucket && !budget->second.bucket->take())) {
+        m_log.trace("controller: Update of %s deferred", module_name);
+        budget->second.pending = true;
+        budget->second.deferred++;
+        defer_update();
+        return;
+      }
+    }
+
+    if (priority != update_priority::HIGH &&
+        !m_throttler->passthrough(m_throttle_strategy)) {
       m_log.trace("controller: Update event throttled");
+      if (budget != m_budgets.end()) {
+        budget->second.pending = true;
+        budget->second.deferred++;
+      }
+      defer_update();
       return;
     }
 
+    // Pending updates are drawn as part of this frame
+    for (auto&& pending : m_budgets) pending.second.pending = false;
+
+    frame_t frame;
+    frame.emplace_back(m_bar.get(), compose(m_bar->settings()));
+
+    for (auto&& output : m_outputs) {
+      if (output.modules.empty())
+        frame.emplace_back(output.window.get(), frame.front().second);
+      else
+        frame.emplace_back(
+            output.window.get(), compose(output.window->settings(), &output.modules));
+    }
+
+    if (!m_frames.put(move(frame)))
+      m_log.trace("controller: Dropped frame that was not drawn yet");
+  }
+
+  /**
+   * Draw a composed frame
+   */
+  void render(const frame_t& frame) {
+    if (frame.empty())
+      return;
+
+    auto& primary = frame.front();
+
+    if (m_stdout) {
+      std::cout << primary.second << std::endl;
+      return;
+    }
+
+    primary.first->parse(primary.second);
+
+    for (auto output = frame.begin() + 1; output != frame.end(); output++) {
+      // Outputs of the same width reuse the frame drawn by the primary bar
+      if (!output->first->mirror(*primary.first, output->second))
+        output->first->parse(output->second);
+    }
+  }
+
+  /**
+   * Build the input string for a bar from the module output
+   *
+   * @param substitutes Per-monitor module instances used in place of the shared ones
+   */
+  string compose(const bar_settings& bar, const map<string, module_t>* substitutes = nullptr) {
     string contents{""};
-    string separator{m_bar->settings().separator};
+    string separator{bar.separator};
 
-    string padding_left(m_bar->settings().padding_left, ' ');
-    string padding_right(m_bar->settings().padding_right, ' ');
+    string padding_left(bar.padding_left, ' ');
+    string padding_right(bar.padding_right, ' ');
 
-    auto margin_left = m_bar->settings().module_margin_left;
-    auto margin_right = m_bar->settings().module_margin_right;
+    auto margin_left = bar.module_margin_left;
+    auto margin_right = bar.module_margin_right;
 
     for (auto&& block : m_modules) {
       string block_contents;
 
       for (auto&& module : block.second) {
-        auto module_contents = module->contents();
+        auto instance = module.get();
 
-        if (module_contents.empty())
+        if (substitutes != nullptr) {
+          auto substitute = substitutes->find(module->name());
+          if (substitute != substitutes->end())
+            instance = substitute->second.get();
+        }
+
+        auto module_contents = instance->contents();
+
+        if (module_contents->empty())
           continue;
 
         if (!block_contents.empty() && !separator.empty())
@@ -446,7 +1314,7 @@ class controller {
         if (!(block.first == alignment::LEFT && module == block.second.front()))
           block_contents += string(margin_left, ' ');
 
-        block_contents += module->contents();
+        block_contents += *module_contents;
 
         if (!(block.first == alignment::RIGHT && module == block.second.back()))
           block_contents += string(margin_right, ' ');
@@ -477,28 +1345,214 @@ class controller {
       contents += string_util::replace_all(block_contents, "}%{", " ");
     }
 
-    if (m_stdout)
-      std::cout << contents << std::endl;
+    return contents;
+  }
+
+  /**
+   * Wake up the flusher to draw the deferred updates
+   */
+  void defer_update() {
+    {
+      std::lock_guard<std::mutex> lck(m_flushmtx);
+      m_deferred = true;
+    }
+    m_flushcond.notify_one();
+  }
+
+  /**
+   * Suspend or resume updates when the bar windows get hidden or shown,
+   * with several outputs updates continue while any of them can be seen
+   */
+  void on_obscured_change(bool state) {
+    {
+      std::lock_guard<std::mutex> lck(m_suspendmtx);
+      for (auto&& output : m_outputs) state = state && output.window->obscured();
+      m_obscured = state && m_bar->obscured();
+    }
+    update_suspended();
+  }
+
+  /**
+   * Follow changes to the connected outputs and their geometry
+   *
+   * The bars are moved and resized in place and the modules keep
+   * running, a single frame is drawn once all bars are updated.
+   * Additional outputs matching the monitor setting get a bar when
+   * they are connected and lose it when they are disconnected.
+   */
+  void on_output_change() {
+    if (!m_running)
+      return;
+
+    vector<monitor_t> monitors;
+
+    try {
+      monitors = randr_util::get_monitors(m_connection, m_connection.root());
+    } catch (const std::exception& err) {
+      m_log.err("Failed to query outputs (%s)", err.what());
+      return;
+    }
+
+    auto find_monitor = [&](const string& name) -> monitor_t {
+      for (auto&& monitor : monitors) {
+        if (monitor->name == name)
+          return monitor;
+      }
+      return {};
+    };
+
+    auto primary = find_monitor(m_bar->settings().monitor->name);
+
+    if (!primary) {
+      m_log.warn("Output %s was disconnected, restarting...", m_bar->settings().monitor->name);
+      m_restart = true;
+      kill(getpid(), SIGUSR1);
+      return;
+    }
+
+    vector<module_t> removed;
+    vector<module_interface*> started;
+
+    {
+      std::lock_guard<std::mutex> suspendguard(m_suspendmtx);
+      std::lock_guard<std::timed_mutex> guard(m_mutex);
+      std::lock_guard<std::mutex> clickguard(m_clickmtx);
+      std::lock_guard<std::mutex> renderguard(m_rendermtx);
+
+      // The pending frame may refer to the bars that are removed
+      m_frames.clear();
+
+      try {
+        if (m_bar->reconfigure(primary) && m_traymanager)
+          m_traymanager->move(m_bar->tray());
+      } catch (const application_error& err) {
+        m_log.err("Failed to move bar to output %s (%s)", primary->name, err.what());
+      }
+
+      for (auto output = m_outputs.begin(); output != m_outputs.end();) {
+        auto name = output->window->settings().monitor->name;
+        auto monitor = find_monitor(name);
+
+        if (!monitor) {
+          m_log.info("Output %s was disconnected, removing bar", name);
+          for (auto&& module : output->modules) removed.emplace_back(move(module.second));
+          output = m_outputs.erase(output);
+          continue;
+        }
+
+        try {
+          output->window->reconfigure(monitor);
+        } catch (const application_error& err) {
+          m_log.err("Failed to move bar to output %s (%s)", name, err.what());
+        }
+
+        output++;
+      }
+
+      auto pattern = m_conf.get<string>(m_conf.bar_section(), "monitor", "");
+
+      for (auto&& name : randr_util::match_monitors(monitors, pattern)) {
+        if (name == primary->name || !find_monitor(name))
+          continue;
+
+        auto existing = std::find_if(m_outputs.begin(), m_outputs.end(), [&](const bar_output& o) {
+          return o.window->settings().monitor->name == name;
+        });
+
+        if (existing != m_outputs.end() || !create_output(name))
+          continue;
+
+        m_log.info("Output %s was connected, adding bar", name);
+
+        try {
+          create_output_modules(m_outputs.back());
+        } catch (const std::exception& err) {
+          m_log.err("Failed to create modules for output %s (%s)", name, err.what());
+        }
+
+        for (auto&& module : m_outputs.back().modules) started.emplace_back(module.second.get());
+      }
+
+      index_events();
+    }
+
+    for (auto&& module : started) start_module(module);
+
+    // Stop the modules of the removed outputs before destroying them
+    for (auto&& module : removed) module->stop();
+    removed.clear();
+
+    on_module_update("");
+  }
+
+  /**
+   * Suspend or resume updates when the screensaver or DPMS state changes
+   */
+  void on_display_change(bool active) {
+    m_displayoff = !active;
+    update_suspended();
+  }
+
+  /**
+   * Stop rendering and pause the timer modules while the bar can't be seen
+   *
+   * When the bar becomes visible again the timer modules update right away
+   * and a single frame is drawn once their output is in
+   */
+  void update_suspended() {
+    std::lock_guard<std::mutex> lck(m_suspendmtx);
+
+    if (!m_running)
+      return;
+
+    bool suspend = m_obscured || m_displayoff;
+
+    if (suspend == m_suspended)
+      return;
+
+    if (suspend)
+      m_log.info("Bar is not visible, suspending updates");
     else
-      m_bar->parse(contents);
+      m_log.info("Bar is visible again, resuming updates");
+
+    m_resuming = !suspend;
+    m_suspended = suspend;
+    m_bar->suspend(suspend);
+
+    for (auto&& output : m_outputs) output.window->suspend(suspend);
+
+    {
+      std::lock_guard<std::timed_mutex> guard(m_mutex);
+
+      for (auto&& module : all_modules()) module->suspend(suspend);
+    }
+
+    if (!suspend)
+      defer_update();
   }
 
   void on_module_stop(string /* module_name */) {
     if (!m_running)
       return;
 
-    for (auto&& block : m_modules) {
-      for (auto&& module : block.second) {
-        if (module->running())
-          return;
-      }
+    for (auto&& module : all_modules()) {
+      if (module->running())
+        return;
     }
 
     m_log.warn("No running modules, raising SIGTERM");
     kill(getpid(), SIGTERM);
   }
 
-  void on_module_click(string input) {
+  void on_xresources_change() {
+    if (!m_running)
+      return;
+
+    m_log.info("X resources changed...");
+    kill(getpid(), SIGUSR1);
+  }
+
+  void on_module_click(string input, string monitor) {
     if (!m_clickmtx.try_lock()) {
       this_thread::yield();
       return;
@@ -506,9 +1560,18 @@ class controller {
 
     std::lock_guard<std::mutex> guard(m_clickmtx, std::adopt_lock);
 
-    for (auto&& block : m_modules) {
-      for (auto&& module : block.second) {
-        if (!module->receive_events())
+    for (auto&& len : m_eventprefixlens) {
+      if (len > input.length())
+        continue;
+
+      auto handlers = m_eventhandlers.find(input.substr(0, len));
+
+      if (handlers == m_eventhandlers.end())
+        continue;
+
+      for (auto&& module : handlers->second) {
+        auto output = m_eventoutputs.find(module);
+        if (output != m_eventoutputs.end() && output->second != monitor)
           continue;
         if (module->handle_event(input))
           return;
@@ -518,23 +1581,18 @@ class controller {
     m_log.trace("controller: Unrecognized input '%s'", input);
     m_log.trace("controller: Forwarding input to shell");
 
-    auto command = command_util::make_command("/usr/bin/env\nsh\n-c\n" + input);
-
-    try {
-      command->exec(false);
-      command->tail([this](std::string output) { m_log.trace("> %s", output); });
-      command->wait();
-    } catch (const application_error& err) {
-      m_log.err(err.what());
-    }
+    if (!m_runner->run("/usr/bin/env\nsh\n-c\n" + input,
+            [this](std::string output) { m_log.trace("> %s", output); }))
+      m_log.info("Ignoring click, command is already running (%s)", input);
   }
 
  private:
   connection& m_connection;
   registry m_registry{m_connection};
   const logger& m_log;
-  const config& m_conf;
+  config& m_conf;
   unique_ptr<bar> m_bar;
+  vector<bar_output> m_outputs;
   unique_ptr<traymanager> m_traymanager;
 
   std::timed_mutex m_mutex;
@@ -543,6 +1601,39 @@ class controller {
   stateflag m_stdout{false};
   stateflag m_running{false};
   stateflag m_reload{false};
+  stateflag m_startup{true};
+  stateflag m_modules_ready{false};
+
+  std::mutex m_readymtx;
+  std::condition_variable m_readycond;
+  chrono::steady_clock::time_point m_startup_begin;
+  map<string, chrono::milliseconds> m_setup_timeouts;
+
+  stateflag m_obscured{false};
+  stateflag m_displayoff{false};
+  stateflag m_suspended{false};
+  stateflag m_resuming{false};
+  std::mutex m_suspendmtx;
+  unique_ptr<screensaver_watch> m_screensaver;
+
+  stateflag m_restart{false};
+  stateflag m_confchanged{false};
+  unique_ptr<throttle_util::debouncer> m_outputwatch;
+
+  std::mutex m_rendermtx;
+  threading_util::mailbox<frame_t> m_frames;
+
+  string m_snapshot;
+  string m_snapshot_key;
+  string m_snapshot_path;
+  chrono::seconds m_snapshot_interval{60};
+  std::mutex m_snapshotmtx;
+  std::condition_variable m_snapshotcond;
+
+  stateflag m_deferred{false};
+  std::mutex m_flushmtx;
+  std::condition_variable m_flushcond;
+  chrono::milliseconds m_flush_interval{60};
 
   sigset_t m_waitmask;
 
@@ -551,7 +1642,14 @@ class controller {
   vector<thread> m_threads;
   map<alignment, vector<module_t>> m_modules;
 
+  std::unordered_map<string, vector<module_interface*>> m_eventhandlers;
+  vector<size_t> m_eventprefixlens;
+  std::unordered_map<module_interface*, string> m_eventoutputs;
+
+  map<string, update_budget> m_budgets;
+
   unique_ptr<throttle_util::event_throttler> m_throttler;
+  command_util::runner_t m_runner;
   throttle_util::strategy::try_once_or_leave_yolo m_throttle_strategy;
 };
 
@@ -566,7 +1664,7 @@ namespace {
         di::bind<>().to(confwatch),
         configure_connection(),
         configure_logger(),
-        configure_config(),
+        configure_config<config&>(),
         configure_bar(),
         configure_traymanager());
     // clang-format on
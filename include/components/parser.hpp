@@ -5,6 +5,7 @@
 #include "components/types.hpp"
 #include "utils/math.hpp"
 #include "utils/string.hpp"
+#include "utils/utf8.hpp"
 
 LEMONBUDDY_NS
 
@@ -28,9 +29,11 @@ class parser {
         codeblock(data.substr(2, pos - 2));
         data.erase(0, pos + 1);
       } else {
-        if ((pos = data.find("%{")) == string::npos)
+        // An unterminated "%{" is written as text, so always consume at
+        // least one character to guarantee progress
+        if ((pos = data.find("%{", 1)) == string::npos)
           pos = data.length();
-        data.erase(0, text(data.substr(0, pos)));
+        data.erase(0, std::max<size_t>(1, text(data.substr(0, pos))));
       }
     }
   }  // }}}
@@ -146,6 +149,33 @@ class parser {
           }
           break;
 
+        case 'S':
+          if (value == "-") {
+            if (g_signals::parser::slot_close)
+              g_signals::parser::slot_close();
+          } else if (g_signals::parser::slot_open) {
+            auto widths = string_util::split(value, ':');
+            int min_width{widths.size() > 0 ? std::atoi(widths[0].c_str()) : 0};
+            int max_width{widths.size() > 1 ? std::atoi(widths[1].c_str()) : 0};
+            bool ellipsis{widths.size() > 2 && widths[2] == "e"};
+            g_signals::parser::slot_open(min_width, max_width, ellipsis);
+          }
+          break;
+
+        case 'M':
+          if (value == "-") {
+            if (g_signals::parser::marquee_close)
+              g_signals::parser::marquee_close();
+          } else if (g_signals::parser::marquee_open) {
+            g_signals::parser::marquee_open(std::atoi(value.c_str()));
+          }
+          break;
+
+        case 'I':
+          if (g_signals::parser::image_write)
+            g_signals::parser::image_write(value);
+          break;
+
         default:
           throw unrecognized_token(string{tag});
       }
@@ -157,52 +187,33 @@ class parser {
 
   /**
    * Parse text strings
+   *
+   * Consecutive ascii characters are emitted as a single run
+   * and malformed utf-8 sequences are replaced with U+FFFD
    */
   size_t text(string data) {  // {{{
-    uint8_t* utf = (uint8_t*)data.c_str();
-
-    // if (utf[0] < 0x80) {
-    //   // grab all consecutive ascii chars
-    //   size_t next_tag = data.find("%{");
-    //   string sequence{(next_tag != string::npos) ? data.substr(0, next_tag) : data};
-    //   size_t n = 0;
-    //   while (sequence[n] != '\0' && static_cast<uint8_t>(sequence[n]) < 0x80 && ++n <= next_tag)
-    //     ;
-    //   if (g_signals::parser::ascii_text_write)
-    //     g_signals::parser::ascii_text_write(data.substr(0, n));
-    //   return data.length();
-    // }
-
-    if (utf[0] < 0x80) {
-      if (g_signals::parser::ascii_text_write)
-        g_signals::parser::ascii_text_write(utf[0]);
-      return 1;
-    } else if ((utf[0] & 0xe0) == 0xc0) {  // 2 byte utf-8 sequence
-      if (g_signals::parser::unicode_text_write)
-        g_signals::parser::unicode_text_write((utf[0] & 0x1f) << 6 | (utf[1] & 0x3f));
-      return 2;
-    } else if ((utf[0] & 0xf0) == 0xe0) {  // 3 byte utf-8 sequence
-      if (g_signals::parser::unicode_text_write)
-        g_signals::parser::unicode_text_write(
-            (utf[0] & 0xf) << 12 | (utf[1] & 0x3f) << 6 | (utf[2] & 0x3f));
-      return 3;
-    } else if ((utf[0] & 0xf8) == 0xf0) {  // 4 byte utf-8 sequence
-      if (g_signals::parser::unicode_text_write)
-        g_signals::parser::unicode_text_write(0xfffd);
-      return 4;
-    } else if ((utf[0] & 0xfc) == 0xf8) {  // 5 byte utf-8 sequence
-      if (g_signals::parser::unicode_text_write)
-        g_signals::parser::unicode_text_write(0xfffd);
-      return 5;
-    } else if ((utf[0] & 0xfe) == 0xfc) {  // 6 byte utf-8 sequence
+    auto utf = reinterpret_cast<const uint8_t*>(data.data());
+    size_t len = data.length();
+    size_t pos = 0;
+
+    while (pos < len) {
+      size_t n = utf8_util::ascii_run(utf + pos, len - pos);
+
+      if (n > 0) {
+        if (g_signals::parser::ascii_text_write)
+          g_signals::parser::ascii_text_write(data.substr(pos, n));
+        pos += n;
+        continue;
+      }
+
+      uint32_t codepoint;
+      pos += utf8_util::decode(utf + pos, len - pos, codepoint);
+
       if (g_signals::parser::unicode_text_write)
-        g_signals::parser::unicode_text_write(0xfffd);
-      return 6;
-    } else {  // invalid utf-8 sequence
-      if (g_signals::parser::ascii_text_write)
-        g_signals::parser::ascii_text_write(utf[0]);
-      return 1;
+        g_signals::parser::unicode_text_write(codepoint);
     }
+
+    return len;
   }  // }}}
 
  protected:
@@ -13,8 +13,11 @@ namespace g_signals {
    * Signals used to communicate with the bar window
    */
   namespace bar {
-    static function<void(string)> action_click;
+    static function<void(string, string)> action_click;
     static function<void(bool)> visibility_change;
+    static function<void(bool)> obscured_change;
+    static function<void()> output_change;
+    static function<void()> xresources_change;
   }
 
   /**
@@ -27,11 +30,16 @@ namespace g_signals {
     static function<void(attribute)> attribute_toggle;
     static function<void(mousebtn, string)> action_block_open;
     static function<void(mousebtn)> action_block_close;
+    static function<void(int, int, bool)> slot_open;
+    static function<void()> slot_close;
+    static function<void(int)> marquee_open;
+    static function<void()> marquee_close;
     static function<void(gc, color)> color_change;
     static function<void(int)> font_change;
     static function<void(int)> pixel_offset;
-    static function<void(uint16_t)> ascii_text_write;
-    static function<void(uint16_t)> unicode_text_write;
+    static function<void(string)> ascii_text_write;
+    static function<void(uint32_t)> unicode_text_write;
+    static function<void(string)> image_write;
   }
 
   /**
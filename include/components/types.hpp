@@ -8,7 +8,7 @@ LEMONBUDDY_NS
 
 enum class border { NONE = 0, TOP, BOTTOM, LEFT, RIGHT, ALL };
 enum class alignment { NONE = 0, LEFT, CENTER, RIGHT };
-enum class syntaxtag { NONE = 0, A, B, F, T, U, O, R, o, u };
+enum class syntaxtag { NONE = 0, A, B, F, T, U, O, R, S, M, I, o, u };
 enum class attribute { NONE = 0, o = 2, u = 4 };
 enum class mousebtn { NONE = 0, LEFT, MIDDLE, RIGHT, SCROLL_UP, SCROLL_DOWN };
 enum class gc { NONE = 0, BG, FG, OL, UL, BT, BB, BL, BR };
@@ -105,6 +105,38 @@ struct action_block {
 #endif
 };
 
+struct slot_block {
+  slot_block() = default;
+  int16_t min_width{0};
+  int16_t max_width{0};
+  bool ellipsis{false};
+  alignment align;
+  int16_t start_x{0};
+  int16_t end_x{0};
+  bool active{true};
+  bool overflowed{false};
+  string contents;
+
+  // Drawing state when the slot was opened
+  int attributes{0};
+  int fontindex{0};
+  map<gc, color> colors;
+};
+
+struct marquee_block {
+  marquee_block() = default;
+  int16_t width{0};
+  int16_t text_width{0};
+  int16_t offset{0};
+  alignment align;
+  int16_t start_x{0};
+  int16_t end_x{0};
+  bool active{true};
+  vector<uint32_t> glyphs;
+  string key;
+  uint32_t pixmap{0};
+};
+
 struct wmsettings_bspwm {};
 
 LEMONBUDDY_NS_END
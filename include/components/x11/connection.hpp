@@ -30,9 +30,17 @@ class connection : public xpp_connection {
 
   /**
    * Preload required xcb atoms
+   *
+   * All requests are sent before waiting for the first reply
    */
   auto preload_atoms() {
-    for (auto&& a : ATOMS) *a.atom = intern_atom(false, a.len, a.name).atom();
+    vector<decltype(intern_atom(false, 0, ""))> replies;
+    for (auto&& a : ATOMS) replies.emplace_back(intern_atom(false, a.len, a.name));
+
+    size_t i = 0;
+    for (auto&& a : ATOMS) *a.atom = replies[i++].atom();
+
+    count_roundtrip();
   }
 
   /**
@@ -50,6 +58,25 @@ class connection : public xpp_connection {
     randr().query_version(XCB_RANDR_MAJOR_VERSION, XCB_RANDR_MINOR_VERSION);
     if (!extension<xpp::randr::extension>()->present)
       throw application_error("Missing X extension: RandR");
+
+    count_roundtrip();
+  }
+
+  /**
+   * Record that the caller had to wait for the server
+   *
+   * Every request that blocks on a reply or a checked error
+   * should be counted, see xlib::count_roundtrip
+   */
+  void count_roundtrip(size_t count = 1) {
+    xlib::count_roundtrip(count);
+  }
+
+  /**
+   * Get the number of recorded round-trips
+   */
+  size_t roundtrips() const {
+    return xlib::roundtrips();
   }
 
   /**
@@ -100,6 +127,26 @@ class connection : public xpp_connection {
     flush();
   }
 
+  /**
+   * Wait for the next event and take the ones queued behind it
+   *
+   * The wait happens inside xcb, so events that other threads read
+   * from the socket while waiting for a reply wake it up as well
+   *
+   * @return empty if the connection failed
+   */
+  vector<shared_ptr<xcb_generic_event_t>> wait_for_events() {
+    vector<shared_ptr<xcb_generic_event_t>> events;
+    xcb_generic_event_t* evt = xcb_wait_for_event(*this);
+
+    while (evt != nullptr) {
+      events.emplace_back(evt, free);
+      evt = xcb_poll_for_queued_event(*this);
+    }
+
+    return events;
+  }
+
   /**
    * Sends a dummy event to the specified window
    * Used to interrupt blocking wait call
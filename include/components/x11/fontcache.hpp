@@ -0,0 +1,155 @@
+#pragma once
+
+#include <X11/Xft/Xft.h>
+#include <fontconfig/fontconfig.h>
+#include <sys/stat.h>
+#include <mutex>
+
+#include "common.hpp"
+#include "utils/snapshot.hpp"
+
+LEMONBUDDY_NS
+
+/**
+ * Persistent cache of the fonts that fontconfig resolves names to
+ *
+ * Matching a pattern against all installed fonts is the slowest
+ * part of opening an Xft font, so the matched pattern, which names
+ * the font file and face index, is stored on disk. The entries are
+ * tied to a key built from the fontconfig configuration files, the
+ * font directories and the X resources, so changing any of them
+ * invalidates the cache.
+ */
+class fontcache {
+ public:
+  static fontcache& instance() {
+    static fontcache cache;
+    return cache;
+  }
+
+  /**
+   * Check if the name is known to resolve to an Xft font
+   */
+  bool contains(Display* display, const string& name) {  // {{{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    load(display);
+    return m_entries.find(name) != m_entries.end();
+  }  // }}}
+
+  /**
+   * Get the pattern that the font name resolves to, the caller
+   * takes ownership of the returned pattern
+   *
+   * @return nullptr if the name could not be matched
+   */
+  FcPattern* match(Display* display, const string& name) {  // {{{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    load(display);
+
+    auto entry = m_entries.find(name);
+
+    if (entry != m_entries.end()) {
+      auto cached = FcNameParse(reinterpret_cast<const FcChar8*>(entry->second.c_str()));
+      if (cached != nullptr)
+        return cached;
+      m_entries.erase(entry);
+    }
+
+    auto pattern = FcNameParse(reinterpret_cast<const FcChar8*>(name.c_str()));
+    if (pattern == nullptr)
+      return nullptr;
+
+    FcResult result;
+    auto matched = XftFontMatch(display, XDefaultScreen(display), pattern, &result);
+    FcPatternDestroy(pattern);
+
+    if (matched == nullptr)
+      return nullptr;
+
+    auto unparsed = FcNameUnparse(matched);
+
+    if (unparsed != nullptr) {
+      m_entries[name] = reinterpret_cast<const char*>(unparsed);
+      free(unparsed);
+      snapshot_util::save(m_path, snapshot_util::serialize(m_key, m_entries));
+    }
+
+    return matched;
+  }  // }}}
+
+  /**
+   * Drop the entry for a name whose cached pattern failed to open
+   */
+  void invalidate(const string& name) {  // {{{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_entries.erase(name);
+  }  // }}}
+
+ protected:
+  fontcache() = default;
+
+  /**
+   * Read the cache file the first time it's needed
+   */
+  void load(Display* display) {  // {{{
+    if (m_loaded)
+      return;
+
+    m_loaded = true;
+    m_path = path();
+    m_key = config_key(display);
+    m_entries = snapshot_util::load(m_path, m_key);
+  }  // }}}
+
+  /**
+   * @return empty string if neither XDG_CACHE_HOME nor HOME is set
+   */
+  static string path() {  // {{{
+    auto cache_dir = read_env("XDG_CACHE_HOME");
+    if (cache_dir.empty() && has_env("HOME"))
+      cache_dir = read_env("HOME") + "/.cache";
+    if (cache_dir.empty())
+      return "";
+    return cache_dir + "/lemonbuddy-fonts.cache";
+  }  // }}}
+
+  /**
+   * Build a key that changes with the fontconfig configuration,
+   * the installed fonts and the Xft resources (e.g. Xft.dpi)
+   */
+  static string config_key(Display* display) {  // {{{
+    string key{to_string(FcGetVersion())};
+
+    FcInit();
+
+    for (auto list : {FcConfigGetConfigFiles(nullptr), FcConfigGetFontDirs(nullptr)}) {
+      if (list == nullptr)
+        continue;
+
+      FcChar8* file;
+      while ((file = FcStrListNext(list)) != nullptr) {
+        struct stat info {};
+        stat(reinterpret_cast<const char*>(file), &info);
+        key += "\n" + string{reinterpret_cast<const char*>(file)} + " " +
+               to_string(info.st_mtime);
+      }
+
+      FcStrListDone(list);
+    }
+
+    auto resources = XResourceManagerString(display);
+    if (resources != nullptr)
+      key += "\n" + string{resources};
+
+    return to_string(std::hash<string>{}(key));
+  }  // }}}
+
+ private:
+  std::mutex m_mutex;
+  bool m_loaded{false};
+  string m_path;
+  string m_key;
+  map<string, string> m_entries;
+};
+
+LEMONBUDDY_NS_END
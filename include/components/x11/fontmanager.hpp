@@ -10,8 +10,10 @@
 #include "components/logger.hpp"
 #include "components/x11/color.hpp"
 #include "components/x11/connection.hpp"
+#include "components/x11/fontcache.hpp"
 #include "components/x11/types.hpp"
 #include "components/x11/xlib.hpp"
+#include "utils/cache.hpp"
 #include "utils/memory.hpp"
 #include "utils/mixins.hpp"
 
@@ -19,7 +21,9 @@ LEMONBUDDY_NS
 
 #define XFT_MAXCHARS (1 << 16)
 static array<char, XFT_MAXCHARS> xft_widths;
-static array<wchar_t, XFT_MAXCHARS> xft_chars;
+static array<uint32_t, XFT_MAXCHARS> xft_chars;
+
+#define TEXTRUN_CACHE_SIZE 512
 
 struct fonttype {
   fonttype() {}
@@ -39,13 +43,41 @@ struct fonttype_deleter {
   void operator()(fonttype* f) {
     if (f->xft != nullptr)
       XftFontClose(xlib::get_display(), f->xft);
-    else
+    else if (f->ptr != 0)
       xcb_close_font(xutils::get_connection(), f->ptr);
+    delete f;
   }
 };
 
 using font_t = unique_ptr<fonttype, fonttype_deleter>;
 
+/**
+ * Measured extents of a run of glyphs
+ */
+struct textrun_extents {
+  int width = 0;
+  vector<int> offsets;  // x offset of each glyph relative to the start of the run
+};
+
+struct textrun_key {
+  const fonttype* font;
+  vector<uint32_t> glyphs;
+
+  bool operator==(const textrun_key& other) const {
+    return font == other.font && glyphs == other.glyphs;
+  }
+};
+
+struct textrun_key_hash {
+  size_t operator()(const textrun_key& key) const {
+    size_t hash = std::hash<const fonttype*>{}(key.font);
+    for (auto&& glyph : key.glyphs) hash = (hash ^ glyph) * 1099511628211ULL;
+    return hash;
+  }
+};
+
+using textrun_cache_t = cache_util::lru_cache<textrun_key, textrun_extents, textrun_key_hash>;
+
 class fontmanager {
  public:
   explicit fontmanager(connection& conn, const logger& logger)
@@ -67,72 +99,74 @@ class fontmanager {
       return;
     }
 
-    for (auto&& font : m_fonts) {
-      if (font.first == index) {
-        m_fontindex = index;
-        break;
-      }
-    }
+    if (m_pending.find(index) != m_pending.end())
+      open_pending(index);
+
+    if (m_fonts.find(index) != m_fonts.end())
+      m_fontindex = index;
   }  // }}}
 
+  /**
+   * Add a font, only the first font that opens successfully is
+   * opened right away, the remaining fonts are opened once they
+   * are selected or needed for a glyph the open fonts lack
+   */
   bool load(string name, int fontindex = -1, int offset_y = 0) {  // {{{
-    if (fontindex != -1 && m_fonts.find(fontindex) != m_fonts.end()) {
+    auto exists = m_fonts.find(fontindex) != m_fonts.end() ||
+                  m_pending.find(fontindex) != m_pending.end();
+
+    if (fontindex != -1 && exists) {
       m_logger.warn("A font with index '%i' has already been loaded, skip...", fontindex);
       return false;
     } else if (fontindex == -1) {
-      fontindex = m_fonts.size();
+      fontindex = m_fonts.size() + m_pending.size();
       m_logger.trace("fontmanager: Assign font '%s' to index '%d'", name.c_str(), fontindex);
     } else {
       m_logger.trace("fontmanager: Add font '%s' to index '%i'", name, fontindex);
     }
 
-    m_fonts.emplace(make_pair(fontindex, font_t{new fonttype(), fonttype_deleter{}}));
-    m_fonts[fontindex]->offset_y = offset_y;
-    m_fonts[fontindex]->ptr = 0;
-    m_fonts[fontindex]->xft = nullptr;
-
-    if (open_xcb_font(m_fonts[fontindex], name)) {
-      m_logger.trace("fontmanager: Successfully loaded X font '%s'", name);
-    } else if ((m_fonts[fontindex]->xft = XftFontOpenName(m_display, 0, name.c_str())) != nullptr) {
-      m_fonts[fontindex]->ptr = 0;
-      m_fonts[fontindex]->ascent = m_fonts[fontindex]->xft->ascent;
-      m_fonts[fontindex]->descent = m_fonts[fontindex]->xft->descent;
-      m_fonts[fontindex]->height = m_fonts[fontindex]->ascent + m_fonts[fontindex]->descent;
-      m_logger.trace("fontmanager: Successfully loaded Freetype font '%s'", name);
-    } else {
-      return false;
-    }
-
-    int max_height = 0;
-
-    for (auto& iter : m_fonts)
-      if (iter.second->height > max_height)
-        max_height = iter.second->height;
-
-    for (auto& iter : m_fonts) {
-      iter.second->height = max_height;
+    if (!m_fonts.empty()) {
+      m_logger.trace("fontmanager: Defer loading of font '%s' until it's needed", name);
+      m_pending.emplace(fontindex, make_pair(name, offset_y));
+      return true;
     }
 
-    return true;
+    return open(fontindex, name, offset_y);
   }  // }}}
 
-  font_t& match_char(uint16_t chr) {  // {{{
+  font_t& match_char(uint32_t chr) {  // {{{
     static font_t notfound;
     if (!m_fonts.empty()) {
-      if (m_fontindex != -1 && size_t(m_fontindex) <= m_fonts.size()) {
+      if (m_fontindex != -1 && size_t(m_fontindex) <= m_fonts.size() + m_pending.size()) {
         auto iter = m_fonts.find(m_fontindex);
         if (iter != m_fonts.end() && has_glyph(iter->second, chr))
           return iter->second;
       }
-      for (auto& font : m_fonts) {
-        if (has_glyph(font.second, chr))
-          return font.second;
+    }
+
+    // Walk the fonts in the configured order, a pending font is opened when
+    // its turn comes so that the result doesn't depend on what was drawn
+    for (int index = -1;;) {
+      auto font = m_fonts.upper_bound(index);
+      auto pending = m_pending.upper_bound(index);
+
+      if (pending != m_pending.end() && (font == m_fonts.end() || pending->first < font->first)) {
+        index = pending->first;
+        if (open_pending(index) && has_glyph(m_fonts[index], chr))
+          return m_fonts[index];
+      } else if (font != m_fonts.end()) {
+        index = font->first;
+        if (has_glyph(font->second, chr))
+          return font->second;
+      } else {
+        break;
       }
     }
+
     return notfound;
   }  // }}}
 
-  int char_width(font_t& font, uint16_t chr) {  // {{{
+  int char_width(font_t& font, uint32_t chr) {  // {{{
     if (!font)
       return 0;
 
@@ -162,6 +196,35 @@ class fontmanager {
     return 0;
   }  // }}}
 
+  /**
+   * Get the advance and glyph offsets of a run of characters
+   *
+   * Results are cached per font since most of the text that
+   * gets drawn is identical to the previous frame
+   */
+  const textrun_extents& text_extents(font_t& font, const vector<uint32_t>& glyphs) {  // {{{
+    // Reuse the lookup key so that cache hits don't allocate
+    m_textrunkey.font = font.get();
+    m_textrunkey.glyphs.assign(glyphs.begin(), glyphs.end());
+
+    if (auto extents = m_textruns.find(m_textrunkey))
+      return *extents;
+
+    textrun_extents extents;
+    extents.offsets.reserve(glyphs.size());
+
+    for (auto&& glyph : glyphs) {
+      extents.offsets.emplace_back(extents.width);
+      extents.width += char_width(font, glyph);
+    }
+
+    return m_textruns.insert(m_textrunkey, move(extents));
+  }  // }}}
+
+  const textrun_cache_t& textrun_cache() const {  // {{{
+    return m_textruns;
+  }  // }}}
+
   XftColor xftcolor() {  // {{{
     return m_xftcolor;
   }  // }}}
@@ -180,14 +243,82 @@ class fontmanager {
   }  // }}}
 
  protected:
+  bool open(int fontindex, const string& name, int offset_y) {  // {{{
+    font_t font{new fonttype(), fonttype_deleter{}};
+    font->offset_y = offset_y;
+    font->ptr = 0;
+    font->xft = nullptr;
+
+    // Names that resolved to an Xft font before are not X fonts
+    if (!fontcache::instance().contains(m_display, name) && open_xcb_font(font, name)) {
+      m_logger.trace("fontmanager: Successfully loaded X font '%s'", name);
+    } else if ((font->xft = open_xft_font(name)) != nullptr) {
+      font->ascent = font->xft->ascent;
+      font->descent = font->xft->descent;
+      font->height = font->ascent + font->descent;
+      m_logger.trace("fontmanager: Successfully loaded Freetype font '%s'", name);
+    } else {
+      return false;
+    }
+
+    // The baseline depends on the height, so the height of the font opened
+    // on startup is kept for the fonts opened later, otherwise text that
+    // is already drawn would move
+    if (m_fontheight == 0)
+      m_fontheight = font->height;
+    else
+      font->height = m_fontheight;
+
+    m_fonts.emplace(fontindex, move(font));
+
+    return true;
+  }  // }}}
+
+  bool open_pending(int fontindex) {  // {{{
+    auto pending = m_pending.find(fontindex);
+    auto name = pending->second.first;
+    auto offset_y = pending->second.second;
+    m_pending.erase(pending);
+
+    if (open(fontindex, name, offset_y))
+      return true;
+
+    m_logger.warn("Unable to load font '%s'", name);
+    return false;
+  }  // }}}
+
+  XftFont* open_xft_font(const string& name) {  // {{{
+    auto& cache = fontcache::instance();
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+      auto pattern = cache.match(m_display, name);
+
+      if (pattern == nullptr)
+        return nullptr;
+
+      // The font takes ownership of the pattern if it opens
+      auto xft = XftFontOpenPattern(m_display, pattern);
+      if (xft != nullptr)
+        return xft;
+
+      FcPatternDestroy(pattern);
+      cache.invalidate(name);
+    }
+
+    return nullptr;
+  }  // }}}
+
   bool open_xcb_font(font_t& fontptr, string fontname) {  // {{{
     try {
       font xfont(m_connection, m_connection.generate_id());
 
+      // Counted before the check since a missing font throws
+      m_connection.count_roundtrip();
       m_connection.open_font_checked(xfont, fontname);
       m_logger.trace("Found X font '%s'", fontname);
 
       auto query = m_connection.query_font(xfont);
+      m_connection.count_roundtrip();
       fontptr->descent = query->font_descent;
       fontptr->height = query->font_ascent + query->font_descent;
       fontptr->width = query->max_bounds.character_width;
@@ -214,7 +345,7 @@ class fontmanager {
     return false;
   }  // }}}
 
-  bool has_glyph(font_t& font, uint16_t chr) {  // {{{
+  bool has_glyph(font_t& font, uint32_t chr) {  // {{{
     if (font->xft != nullptr) {
       return XftCharExists(m_display, font->xft, (FcChar32)chr) == true;
     } else {
@@ -235,8 +366,13 @@ class fontmanager {
   Colormap m_colormap;
 
   map<int, font_t> m_fonts;
+  map<int, std::pair<string, int>> m_pending;
   int m_fontindex = -1;
+  int m_fontheight = 0;
   XftColor m_xftcolor;
+
+  textrun_cache_t m_textruns{TEXTRUN_CACHE_SIZE};
+  textrun_key m_textrunkey{nullptr, {}};
 };
 
 namespace {
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrender.h>
+#include <map>
+#include <string>
+
+#include "common.hpp"
+#include "components/logger.hpp"
+#include "components/x11/connection.hpp"
+#include "components/x11/xlib.hpp"
+#include "utils/image.hpp"
+
+LEMONBUDDY_NS
+
+struct imagetype {
+  uint16_t width = 0;
+  uint16_t height = 0;
+  Pixmap pixmap = 0;
+  Picture picture = 0;
+};
+
+struct imagetype_deleter {
+  void operator()(imagetype* img) {
+    if (img->picture != 0)
+      XRenderFreePicture(xlib::get_display(), img->picture);
+    if (img->pixmap != 0)
+      XFreePixmap(xlib::get_display(), img->pixmap);
+    delete img;
+  }
+};
+
+using image_t = unique_ptr<imagetype, imagetype_deleter>;
+
+/**
+ * Loads images into server-side ARGB pixmaps
+ *
+ * Each file is decoded and uploaded once, after which drawing
+ * it is a single composite request. Images that fail to load
+ * are remembered so that the error is only reported once.
+ */
+class imagemanager {
+ public:
+  explicit imagemanager(connection& conn, const logger& logger)
+      : m_connection(conn), m_logger(logger) {
+    m_display = xlib::get_display();
+  }
+
+  ~imagemanager() {
+    m_images.clear();
+  }
+
+  /**
+   * Get the image stored at given path, loading it on first use
+   *
+   * @return nullptr if the image could not be loaded
+   */
+  const imagetype* get(const string& path) {  // {{{
+    auto it = m_images.find(path);
+
+    if (it == m_images.end())
+      it = m_images.emplace(path, load(path)).first;
+
+    return it->second.get();
+  }  // }}}
+
+  /**
+   * Drop all images, including the ones that failed to load,
+   * so that they are read from disk again on next use
+   */
+  void clear() {  // {{{
+    m_images.clear();
+  }  // }}}
+
+  /**
+   * Blend the image onto the destination picture
+   */
+  void composite(const imagetype& img, Picture dst, int x, int y) {  // {{{
+    XRenderComposite(m_display, PictOpOver, img.picture, 0, dst, 0, 0, 0, 0, x, y, img.width,
+        img.height);
+  }  // }}}
+
+ protected:
+  image_t load(const string& path) {  // {{{
+    image_util::image decoded;
+
+    try {
+      decoded = image_util::load(expand_path(path));
+    } catch (const image_util::image_error& err) {
+      m_logger.err("Failed to load image '%s' (%s)", path, err.what());
+      return image_t{};
+    }
+
+    XRenderPictFormat* format = XRenderFindStandardFormat(m_display, PictStandardARGB32);
+
+    if (format == nullptr) {
+      m_logger.err("Failed to load image '%s' (no ARGB32 picture format)", path);
+      return image_t{};
+    }
+
+    image_t img{new imagetype(), imagetype_deleter{}};
+    img->width = decoded.width;
+    img->height = decoded.height;
+    img->pixmap = XCreatePixmap(
+        m_display, XDefaultRootWindow(m_display), decoded.width, decoded.height, 32);
+
+    XImage ximage{};
+    ximage.width = decoded.width;
+    ximage.height = decoded.height;
+    ximage.format = ZPixmap;
+    ximage.data = reinterpret_cast<char*>(decoded.pixels.data());
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    ximage.byte_order = MSBFirst;
+#else
+    ximage.byte_order = LSBFirst;
+#endif
+    ximage.bitmap_unit = 32;
+    ximage.bitmap_bit_order = ximage.byte_order;
+    ximage.bitmap_pad = 32;
+    ximage.depth = 32;
+    ximage.bytes_per_line = decoded.width * 4;
+    ximage.bits_per_pixel = 32;
+    XInitImage(&ximage);
+
+    // Xlib splits the upload into several requests if needed
+    auto gc = XCreateGC(m_display, img->pixmap, 0, nullptr);
+    XPutImage(m_display, img->pixmap, gc, &ximage, 0, 0, 0, 0, decoded.width, decoded.height);
+    XFreeGC(m_display, gc);
+
+    img->picture = XRenderCreatePicture(m_display, img->pixmap, format, 0, nullptr);
+
+    m_logger.trace("imagemanager: Loaded image '%s' (%ix%i)", path, img->width, img->height);
+
+    return img;
+  }  // }}}
+
+  string expand_path(const string& path) {  // {{{
+    if (path.compare(0, 2, "~/") == 0 && has_env("HOME"))
+      return read_env("HOME") + path.substr(1);
+    return path;
+  }  // }}}
+
+ private:
+  connection& m_connection;
+  const logger& m_logger;
+
+  Display* m_display{nullptr};
+
+  map<string, image_t> m_images;
+};
+
+namespace {
+  /**
+   * Configure injection module
+   */
+  template <typename T = unique_ptr<imagemanager>>
+  di::injector<T> configure_imagemanager() {
+    return di::make_injector(configure_connection(), configure_logger());
+  }
+}
+
+LEMONBUDDY_NS_END
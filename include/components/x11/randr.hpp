@@ -1,8 +1,11 @@
 #pragma once
 
+#include <algorithm>
+
 #include "common.hpp"
 #include "components/x11/connection.hpp"
 #include "utils/memory.hpp"
+#include "utils/string.hpp"
 
 LEMONBUDDY_NS
 
@@ -41,24 +44,46 @@ namespace randr_util {
 
   /**
    * Create a list of all available randr outputs
+   *
+   * The requests for all outputs, and then for all of their crtcs,
+   * are sent before waiting for the first reply so that the query
+   * costs three round-trips (screen resources, outputs and crtcs)
+   * regardless of the number of outputs
    */
   inline vector<monitor_t> get_monitors(connection& conn, xcb_window_t root) {
     vector<monitor_t> monitors;
-    auto outputs = conn.get_screen_resources(root).outputs();
+    auto resources = conn.get_screen_resources(root);
+    vector<xcb_randr_output_t> outputs{resources.outputs().begin(), resources.outputs().end()};
+
+    vector<decltype(conn.get_output_info(0))> infos;
+    for (auto&& output : outputs) infos.emplace_back(conn.get_output_info(output));
+
+    vector<size_t> connected;
+    vector<decltype(conn.get_crtc_info(0))> crtcs;
 
-    for (auto it = outputs.begin(); it != outputs.end(); it++) {
+    for (size_t i = 0; i < infos.size(); i++) {
       try {
-        auto info = conn.get_output_info(*it);
-        if (info->connection != XCB_RANDR_CONNECTION_CONNECTED)
+        if (infos[i]->connection != XCB_RANDR_CONNECTION_CONNECTED || infos[i]->crtc == XCB_NONE)
           continue;
-        auto crtc = conn.get_crtc_info(info->crtc);
+        connected.emplace_back(i);
+        crtcs.emplace_back(conn.get_crtc_info(infos[i]->crtc));
+      } catch (const xpp::randr::error::bad_output&) {
+      }
+    }
+
+    for (size_t i = 0; i < connected.size(); i++) {
+      try {
+        auto& info = infos[connected[i]];
+        auto& crtc = crtcs[i];
         string name{info.name().begin(), info.name().end()};
-        monitors.emplace_back(make_monitor(*it, name, crtc->width, crtc->height, crtc->x, crtc->y));
+        monitors.emplace_back(make_monitor(
+            outputs[connected[i]], name, crtc->width, crtc->height, crtc->x, crtc->y));
       } catch (const xpp::randr::error::bad_crtc&) {
-      } catch (const xpp::randr::error::bad_output&) {
       }
     }
 
+    conn.count_roundtrip(3);
+
     // use the same sort algo as lemonbar, to match the defaults
     sort(monitors.begin(), monitors.end(), [](monitor_t& m1, monitor_t& m2) -> bool {
       if (m1->x < m2->x || m1->y + m1->h <= m2->y)
@@ -71,14 +96,43 @@ namespace randr_util {
     return monitors;
   }
 
+  /**
+   * Get the names of the monitors matching the bar's monitor setting
+   *
+   * The setting holds a single name, a list of names or "*" to
+   * match all monitors. An empty value matches the first monitor.
+   */
+  inline vector<string> match_monitors(const vector<monitor_t>& monitors, string pattern) {
+    vector<string> names;
+    pattern = string_util::trim(pattern, ' ');
+
+    if (monitors.empty()) {
+      return names;
+    } else if (pattern.empty()) {
+      names.emplace_back(monitors[0]->name);
+    } else if (pattern == "*") {
+      for (auto&& monitor : monitors) names.emplace_back(monitor->name);
+    } else {
+      for (auto&& name : string_util::split(string_util::replace_all(pattern, ",", " "), ' ')) {
+        if (!name.empty() && std::find(names.begin(), names.end(), name) == names.end())
+          names.emplace_back(name);
+      }
+    }
+
+    return names;
+  }
+
   inline void get_backlight_range(connection& conn, const monitor_t& mon, backlight_values& dst) {
     auto reply = conn.query_output_property(mon->randr_output, Backlight);
+    conn.count_roundtrip();
 
     dst.min = 0;
     dst.max = 0;
 
-    if (!reply->range || reply->length != 2)
+    if (!reply->range || reply->length != 2) {
       reply = conn.query_output_property(mon->randr_output, BACKLIGHT);
+      conn.count_roundtrip();
+    }
     if (!reply->range || reply->length != 2)
       return;
 
@@ -90,9 +144,12 @@ namespace randr_util {
 
   inline void get_backlight_value(connection& conn, const monitor_t& mon, backlight_values& dst) {
     auto reply = conn.get_output_property(mon->randr_output, Backlight, XCB_ATOM_NONE, 0, 4, 0, 0);
+    conn.count_roundtrip();
 
-    if (reply->num_items != 1 || reply->format != 32 || reply->type != XCB_ATOM_INTEGER)
+    if (reply->num_items != 1 || reply->format != 32 || reply->type != XCB_ATOM_INTEGER) {
       reply = conn.get_output_property(mon->randr_output, BACKLIGHT, XCB_ATOM_NONE, 0, 4, 0, 0);
+      conn.count_roundtrip();
+    }
     if (reply->num_items == 1 && reply->format == 32 && reply->type == XCB_ATOM_INTEGER)
       dst.val = *reinterpret_cast<uint32_t*>(xcb_randr_get_output_property_data(reply.get().get()));
     else
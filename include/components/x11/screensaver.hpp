@@ -0,0 +1,176 @@
+#pragma once
+
+#include <X11/Xlib.h>
+#include <X11/extensions/dpms.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "common.hpp"
+#include "components/logger.hpp"
+
+#if ENABLE_XSS
+#include <X11/extensions/scrnsaver.h>
+#endif
+
+LEMONBUDDY_NS
+
+/**
+ * Watches the screensaver and DPMS state of the display
+ *
+ * Uses a separate Xlib connection on its own thread so that the
+ * events of the screensaver extension never reach the xcb event
+ * loop. The screensaver state is reported through events, while
+ * the DPMS power level, which has no events, is polled.
+ */
+class screensaver_watch {
+ public:
+  using callback = function<void(bool)>;
+
+  /**
+   * Construct watch
+   */
+  explicit screensaver_watch(const logger& logger, chrono::seconds poll_interval = 5s)
+      : m_log(logger), m_pollinterval(poll_interval) {}
+
+  ~screensaver_watch() {
+    stop();
+  }
+
+  /**
+   * Start watching, the callback is called with false when the
+   * display is turned off and with true when it's turned back on
+   */
+  void start(callback&& fn) {
+    if ((m_display = XOpenDisplay(nullptr)) == nullptr)
+      throw application_error("Failed to open display for screensaver watch");
+
+    if (pipe(m_wakeup) == -1) {
+      XCloseDisplay(m_display);
+      m_display = nullptr;
+      throw system_error("Failed to create wakeup pipe");
+    }
+
+    int event_base, error_base;
+
+#if ENABLE_XSS
+    if (XScreenSaverQueryExtension(m_display, &event_base, &error_base)) {
+      m_ssevent = event_base + ScreenSaverNotify;
+      XScreenSaverSelectInput(m_display, XDefaultRootWindow(m_display), ScreenSaverNotifyMask);
+
+      auto info = XScreenSaverAllocInfo();
+      if (XScreenSaverQueryInfo(m_display, XDefaultRootWindow(m_display), info))
+        m_saveractive = info->state == ScreenSaverOn;
+      XFree(info);
+    } else {
+      m_log.warn("screensaver: MIT-SCREEN-SAVER extension not available");
+    }
+#endif
+
+    m_dpms = DPMSQueryExtension(m_display, &event_base, &error_base) && DPMSCapable(m_display);
+
+    if (!m_dpms)
+      m_log.trace("screensaver: DPMS not available");
+
+    m_callback = forward<decltype(fn)>(fn);
+    m_running = true;
+    m_thread = thread(&screensaver_watch::runner, this);
+  }
+
+  /**
+   * Stop watching and close the connection
+   */
+  void stop() {
+    if (m_thread.joinable()) {
+      m_running = false;
+      if (write(m_wakeup[1], "\n", 1) == -1)
+        m_log.warn("screensaver: Failed to wake up thread");
+      m_thread.join();
+    }
+
+    if (m_display != nullptr) {
+      XCloseDisplay(m_display);
+      m_display = nullptr;
+      close(m_wakeup[0]);
+      close(m_wakeup[1]);
+    }
+  }
+
+ protected:
+  void runner() {
+    m_log.trace("screensaver: Start watch thread");
+
+    bool active = display_active();
+
+    if (!active)
+      m_callback(false);
+
+    while (m_running) {
+      pollfd fds[2]{{ConnectionNumber(m_display), POLLIN, 0}, {m_wakeup[0], POLLIN, 0}};
+      int timeout{-1};
+
+      // Without DPMS there is nothing to poll, only the events
+      if (m_dpms)
+        timeout = chrono::duration_cast<chrono::milliseconds>(m_pollinterval).count();
+
+      XFlush(m_display);
+      poll(fds, 2, timeout);
+
+      if (!m_running)
+        break;
+
+      while (XPending(m_display)) {
+        XEvent evt;
+        XNextEvent(m_display, &evt);
+
+#if ENABLE_XSS
+        if (evt.type == m_ssevent) {
+          auto notify = reinterpret_cast<XScreenSaverNotifyEvent*>(&evt);
+          m_saveractive = notify->state == ScreenSaverOn;
+          m_log.trace("screensaver: Screensaver %s", m_saveractive ? "activated" : "deactivated");
+        }
+#endif
+      }
+
+      if (active != display_active()) {
+        active = !active;
+        m_callback(active);
+      }
+    }
+
+    m_log.trace("screensaver: Stop watch thread");
+  }
+
+  /**
+   * Check if the screensaver is inactive and the monitor powered on
+   */
+  bool display_active() {
+    if (m_saveractive)
+      return false;
+    if (!m_dpms)
+      return true;
+
+    CARD16 level;
+    BOOL enabled;
+
+    if (!DPMSInfo(m_display, &level, &enabled) || !enabled)
+      return true;
+
+    return level == DPMSModeOn;
+  }
+
+ private:
+  const logger& m_log;
+  chrono::seconds m_pollinterval;
+
+  Display* m_display{nullptr};
+  int m_wakeup[2]{-1, -1};
+  int m_ssevent{-1};
+  bool m_saveractive{false};
+  bool m_dpms{false};
+
+  callback m_callback;
+  stateflag m_running{false};
+  thread m_thread;
+};
+
+LEMONBUDDY_NS_END
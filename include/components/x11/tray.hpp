@@ -224,6 +224,21 @@ class traymanager
     m_connection.flush();
   }
 
+  /**
+   * Move the container window along with the bar
+   */
+  void move(const tray_settings& settings) {
+    m_settings.orig_x = settings.orig_x;
+    m_settings.orig_y = settings.orig_y;
+
+    if (m_tray == XCB_NONE)
+      return;
+
+    const uint32_t val[2]{
+        static_cast<uint32_t>(calculate_x()), static_cast<uint32_t>(calculate_y())};
+    m_connection.configure_window(m_tray, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, val);
+  }
+
   /**
    * Reconfigure container window size and
    * reposition embedded clients
@@ -348,6 +363,7 @@ class traymanager
     string name{"_NET_SYSTEM_TRAY_S" + to_string(m_connection.default_screen())};
     auto reply = m_connection.intern_atom(false, name.length(), name.c_str());
     m_atom = reply.atom();
+    m_connection.count_roundtrip();
   }
 
   /**
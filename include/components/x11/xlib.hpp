@@ -1,6 +1,7 @@
 #pragma once
 
 #include <X11/Xutil.h>
+#include <atomic>
 
 #include "common.hpp"
 
@@ -9,6 +10,7 @@ LEMONBUDDY_NS
 namespace xlib {
   static Display* g_display = nullptr;
   static Visual* g_visual = nullptr;
+  static std::atomic<size_t> g_roundtrips{0};
 
   /**
    * Get pointer of Xlib Display
@@ -40,6 +42,23 @@ namespace xlib {
     return g_visual;
   }
 
+  /**
+   * Record that the caller had to wait for the server
+   *
+   * The xcb connection is taken from the Xlib display, so this
+   * covers waits made through either of them
+   */
+  inline void count_roundtrip(size_t count = 1) {
+    g_roundtrips += count;
+  }
+
+  /**
+   * Get the number of recorded round-trips
+   */
+  inline size_t roundtrips() {
+    return g_roundtrips;
+  }
+
   /**
    * RAII wrapper for Xlib display locking
    */
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <X11/Xatom.h>
 #include <X11/Xlib.h>
 #include <X11/Xresource.h>
+#include <mutex>
 
 #include "common.hpp"
 #include "components/x11/xlib.hpp"
@@ -12,13 +14,56 @@ class xresource_manager {
  public:
   explicit xresource_manager() {
     XrmInitialize();
+    reload();
+  }
 
-    if (xlib::get_display() == nullptr)
-      return;
-    if ((m_manager = XResourceManagerString(xlib::get_display())) == nullptr)
-      return;
-    if ((m_db = XrmGetStringDatabase(m_manager)) == nullptr)
-      return;
+  ~xresource_manager() {
+    if (m_db != nullptr)
+      XrmDestroyDatabase(m_db);
+  }
+
+  /**
+   * Load the resource database from the RESOURCE_MANAGER property
+   * of the root window, which is kept up to date by xrdb
+   *
+   * @return true if the resources changed
+   */
+  bool reload() {
+    auto display = xlib::get_display();
+
+    if (display == nullptr)
+      return false;
+
+    Atom type;
+    int format;
+    unsigned long len, remaining;
+    unsigned char* data{nullptr};
+    string resources;
+
+    if (XGetWindowProperty(display, XDefaultRootWindow(display), XA_RESOURCE_MANAGER, 0,
+            0x7fffffff, False, XA_STRING, &type, &format, &len, &remaining, &data) == Success &&
+        data != nullptr) {
+      resources.assign(reinterpret_cast<char*>(data), len);
+    }
+
+    xlib::count_roundtrip();
+
+    if (data != nullptr)
+      XFree(data);
+
+    // Values may be looked up from other threads while reloading
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    if (resources == m_resources)
+      return false;
+
+    if (m_db != nullptr)
+      XrmDestroyDatabase(m_db);
+
+    m_resources = resources;
+    m_db = m_resources.empty() ? nullptr : XrmGetStringDatabase(m_resources.c_str());
+
+    return true;
   }
 
   string get_string(string name) const {
@@ -35,7 +80,9 @@ class xresource_manager {
 
  protected:
   string load_value(string key, string res_type, size_t n) const {
-    if (m_manager == nullptr)
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    if (m_db == nullptr)
       return "";
 
     char* type = nullptr;
@@ -50,15 +97,16 @@ class xresource_manager {
   }
 
  private:
-  char* m_manager = nullptr;
-  XrmDatabase m_db;
+  mutable std::mutex m_mutex;
+  string m_resources;
+  XrmDatabase m_db{nullptr};
 };
 
 namespace {
   /**
    * Configure injection module
    */
-  template <typename T = const xresource_manager&>
+  template <typename T = xresource_manager&>
   di::injector<T> configure_xresource_manager() {
     auto instance = factory::generic_singleton<xresource_manager>();
     return di::make_injector(di::bind<>().to(instance));
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <set>
+#include <tuple>
+
 #include "common.hpp"
 #include "components/x11/types.hpp"
 #include "components/x11/xlib.hpp"
@@ -32,6 +35,44 @@ namespace xutils {
   inline void pack_values(uint32_t mask, const xcb_params_gc_t* src, uint32_t* dest) {
     xutils::pack_values(mask, reinterpret_cast<const uint32_t*>(src), dest);
   }
+
+  /**
+   * Drop events that are superseded by a later event of the same kind
+   *
+   * Only the last expose and configure notify of each window, and the
+   * last property notify of each window property, are kept
+   */
+  inline void coalesce_events(vector<shared_ptr<xcb_generic_event_t>>& events) {
+    std::set<std::tuple<uint8_t, xcb_window_t, xcb_atom_t>> seen;
+    vector<shared_ptr<xcb_generic_event_t>> kept;
+
+    for (auto evt = events.rbegin(); evt != events.rend(); evt++) {
+      uint8_t type = (*evt)->response_type & ~0x80;
+      xcb_window_t window{XCB_NONE};
+      xcb_atom_t atom{XCB_NONE};
+
+      switch (type) {
+        case XCB_EXPOSE:
+          window = reinterpret_cast<xcb_expose_event_t*>(evt->get())->window;
+          break;
+        case XCB_CONFIGURE_NOTIFY:
+          window = reinterpret_cast<xcb_configure_notify_event_t*>(evt->get())->window;
+          break;
+        case XCB_PROPERTY_NOTIFY:
+          window = reinterpret_cast<xcb_property_notify_event_t*>(evt->get())->window;
+          atom = reinterpret_cast<xcb_property_notify_event_t*>(evt->get())->atom;
+          break;
+        default:
+          kept.emplace_back(*evt);
+          continue;
+      }
+
+      if (seen.emplace(type, window, atom).second)
+        kept.emplace_back(*evt);
+    }
+
+    events.assign(kept.rbegin(), kept.rend());
+  }
 }
 
 LEMONBUDDY_NS_END
@@ -11,6 +11,8 @@
 #cmakedefine01 ENABLE_MPD
 #cmakedefine01 ENABLE_NETWORK
 #cmakedefine01 ENABLE_I3
+#cmakedefine01 ENABLE_PNG
+#cmakedefine01 ENABLE_XSS
 
 #cmakedefine DISABLE_MODULES
 #cmakedefine DISABLE_TRAY
@@ -47,6 +49,8 @@ auto print_build_info = []() {
               << (ENABLE_I3       ? "+" : "-") << "i3 "
               << (ENABLE_MPD      ? "+" : "-") << "mpd "
               << (ENABLE_NETWORK  ? "+" : "-") << "network "
+              << (ENABLE_PNG      ? "+" : "-") << "png "
+              << (ENABLE_XSS      ? "+" : "-") << "xss "
             << "\n\n"
             << "ALSA_SOUNDCARD        " << ALSA_SOUNDCARD        << "\n"
             << "BSPWM_SOCKET_PATH     " << BSPWM_SOCKET_PATH     << "\n"
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+
 #include "common.hpp"
 #include "components/config.hpp"
 #include "utils/mixins.hpp"
@@ -23,11 +25,15 @@ namespace drawtypes {
     int m_margin = 0;
     size_t m_maxlen = 0;
     bool m_ellipsis = true;
+    int m_marquee = 0;
+    string m_image;
 
-    explicit label(string text, int font) : m_font(font), m_text(text), m_tokenized(m_text) {}
+    explicit label(string text, int font) : m_font(font), m_text(text) {
+      compile();
+    }
     explicit label(string text, string foreground = "", string background = "",
         string underline = "", string overline = "", int font = 0, int padding = 0, int margin = 0,
-        size_t maxlen = 0, bool ellipsis = true)
+        size_t maxlen = 0, bool ellipsis = true, int marquee = 0, string image = "")
         : m_foreground(foreground)
         , m_background(background)
         , m_underline(underline)
@@ -37,28 +43,75 @@ namespace drawtypes {
         , m_margin(margin)
         , m_maxlen(maxlen)
         , m_ellipsis(ellipsis)
-        , m_text(text)
-        , m_tokenized(m_text) {}
+        , m_marquee(marquee)
+        , m_image(image)
+        , m_text(text) {
+      compile();
+    }
 
-    string get() const {
-      return m_tokenized;
+    /**
+     * Get the text with the tokens replaced
+     *
+     * @param maxlen Truncate the text to this many bytes, 0 to disable
+     */
+    string get(size_t maxlen = 0) const {
+      string text;
+      copy_to(text, maxlen);
+      return text;
+    }
+
+    /**
+     * Same as get(), but writes into a buffer that can be reused
+     * between updates without allocating
+     */
+    void copy_to(string& text, size_t maxlen = 0) const {
+      size_t length{0};
+      for (auto&& segment : m_segments)
+        length += segment.slot == -1 ? segment.text.size() : m_values[segment.slot].size();
+
+      if (maxlen == 0 || length <= maxlen)
+        maxlen = length;
+
+      text.clear();
+      text.reserve(maxlen + 3);
+
+      for (auto&& segment : m_segments) {
+        auto& part = segment.slot == -1 ? segment.text : m_values[segment.slot];
+        text.append(part, 0, maxlen - text.size());
+        if (text.size() == maxlen)
+          break;
+      }
+
+      if (maxlen < length && m_ellipsis)
+        text += "...";
     }
 
     operator bool() {
-      return !m_text.empty();
+      return !m_text.empty() || !m_image.empty();
     }
 
     label_t clone() {
       return label_t{new label(m_text, m_foreground, m_background, m_underline, m_overline, m_font,
-          m_padding, m_margin, m_maxlen, m_ellipsis)};
+          m_padding, m_margin, m_maxlen, m_ellipsis, m_marquee, m_image)};
     }
 
     void reset_tokens() {
-      m_tokenized = m_text;
+      m_values = m_tokens;
+    }
+
+    void replace_token(const string& token, string replacement) {
+      for (size_t i = 0; i < m_tokens.size(); i++) {
+        if (m_tokens[i] == token)
+          m_values[i] = move(replacement);
+      }
     }
 
-    void replace_token(string token, string replacement) {
-      m_tokenized = string_util::replace_all(m_tokenized, token, replacement);
+    /**
+     * Check if the text contains the token, so that the value
+     * doesn't need to be computed for labels that don't show it
+     */
+    bool has_token(const string& token) const {
+      return std::find(m_tokens.begin(), m_tokens.end(), token) != m_tokens.end();
     }
 
     void replace_defined_values(const label_t& label) {
@@ -91,10 +144,62 @@ namespace drawtypes {
         m_maxlen = label->m_maxlen;
         m_ellipsis = label->m_ellipsis;
       }
+      if (m_marquee == 0 && label->m_marquee != 0)
+        m_marquee = label->m_marquee;
+    }
+
+   protected:
+    /**
+     * Split the text into literal text and %token% slots once, so
+     * that replacing the tokens doesn't rescan the whole text
+     */
+    void compile() {
+      size_t start{0};
+      size_t pos{0};
+
+      while ((pos = m_text.find('%', pos)) != string::npos) {
+        auto end = m_text.find('%', pos + 1);
+        if (end == string::npos)
+          break;
+
+        auto name = m_text.substr(pos + 1, end - pos - 1);
+        auto valid = !name.empty() && std::all_of(name.begin(), name.end(), [](char c) {
+          return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+        });
+
+        if (!valid) {
+          pos = end;
+          continue;
+        }
+
+        if (pos > start)
+          m_segments.emplace_back(segment{m_text.substr(start, pos - start), -1});
+
+        auto token = "%" + name + "%";
+        auto slot = std::find(m_tokens.begin(), m_tokens.end(), token) - m_tokens.begin();
+        if (static_cast<size_t>(slot) == m_tokens.size())
+          m_tokens.emplace_back(token);
+
+        m_segments.emplace_back(segment{"", static_cast<int>(slot)});
+        start = pos = end + 1;
+      }
+
+      if (start < m_text.size())
+        m_segments.emplace_back(segment{m_text.substr(start), -1});
+
+      m_values = m_tokens;
     }
 
    private:
-    string m_text, m_tokenized;
+    struct segment {
+      string text;
+      int slot;  // index of the token, -1 for literal text
+    };
+
+    string m_text;
+    vector<segment> m_segments;
+    vector<string> m_tokens;
+    vector<string> m_values;
   };
 
   /**
@@ -105,11 +210,13 @@ namespace drawtypes {
     name = string_util::ltrim(string_util::rtrim(name, '>'), '<');
 
     string text;
+    auto image = conf.get<string>(section, name + "-image", "");
 
-    if (required)
+    // The text is optional for image labels
+    if (required && image.empty())
       text = conf.get<string>(section, name);
     else
-      text = conf.get<string>(section, name, def);
+      text = conf.get<string>(section, name, image.empty() ? def : "");
 
     // clang-format off
     return label_t{new label_t::element_type(text,
@@ -121,7 +228,9 @@ namespace drawtypes {
         conf.get<int>(section, name + "-padding", 0),
         conf.get<int>(section, name + "-margin", 0),
         conf.get<size_t>(section, name + "-maxlen", 0),
-        conf.get<bool>(section, name + "-ellipsis", true))};
+        conf.get<bool>(section, name + "-ellipsis", true),
+        conf.get<int>(section, name + "-marquee", 0),
+        image)};
     // clang-format on
   }
 
@@ -148,21 +148,29 @@ namespace modules {
         return FORMAT_DISCHARGING;
     }
 
-    bool build(builder* builder, string tag) const {
-      if (tag == TAG_ANIMATION_CHARGING)
-        builder->node(m_animation_charging->get());
-      else if (tag == TAG_BAR_CAPACITY) {
-        builder->node(m_bar_capacity->output(m_percentage));
-      } else if (tag == TAG_RAMP_CAPACITY)
-        builder->node(m_ramp_capacity->get_by_percentage(m_percentage));
-      else if (tag == TAG_LABEL_CHARGING)
-        builder->node(m_label_charging);
-      else if (tag == TAG_LABEL_DISCHARGING)
-        builder->node(m_label_discharging);
-      else if (tag == TAG_LABEL_FULL)
-        builder->node(m_label_full);
-      else
-        return false;
+    bool build(builder* builder, tag_t tag) const {
+      switch (tag) {
+        case tag_id(TAG_ANIMATION_CHARGING):
+          builder->node(m_animation_charging->get());
+          break;
+        case tag_id(TAG_BAR_CAPACITY):
+          builder->node(m_bar_capacity->output(m_percentage));
+          break;
+        case tag_id(TAG_RAMP_CAPACITY):
+          builder->node(m_ramp_capacity->get_by_percentage(m_percentage));
+          break;
+        case tag_id(TAG_LABEL_CHARGING):
+          builder->node(m_label_charging);
+          break;
+        case tag_id(TAG_LABEL_DISCHARGING):
+          builder->node(m_label_discharging);
+          break;
+        case tag_id(TAG_LABEL_FULL):
+          builder->node(m_label_full);
+          break;
+        default:
+          return false;
+      }
       return true;
     }
 
@@ -287,8 +287,8 @@ namespace modules {
       return true;
     }
 
-    bool build(builder* builder, string tag) const {
-      if (tag != TAG_LABEL_STATE)
+    bool build(builder* builder, tag_t tag) const {
+      if (tag != tag_id(TAG_LABEL_STATE))
         return false;
 
       int workspace_n = 0;
@@ -330,8 +330,8 @@ namespace modules {
       return true;
     }
 
-    bool receive_events() const {
-      return true;
+    vector<string> event_prefixes() const {
+      return {EVENT_CLICK};
     }
 
    private:
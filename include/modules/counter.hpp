@@ -21,8 +21,8 @@ namespace modules {
       return true;
     }
 
-    bool build(builder* builder, string tag) const {
-      if (tag == TAG_COUNTER) {
+    bool build(builder* builder, tag_t tag) const {
+      if (tag == tag_id(TAG_COUNTER)) {
         builder->node(to_string(m_counter));
         return true;
       }
@@ -73,23 +73,30 @@ namespace modules {
       return true;
     }
 
-    bool build(builder* builder, string tag) const {
-      if (tag == TAG_LABEL)
-        builder->node(m_label);
-      else if (tag == TAG_BAR_LOAD)
-        builder->node(m_barload->output(m_total));
-      else if (tag == TAG_RAMP_LOAD)
-        builder->node(m_rampload->get_by_percentage(m_total));
-      else if (tag == TAG_RAMP_LOAD_PER_CORE) {
-        auto i = 0;
-        for (auto&& load : m_load) {
-          if (i++ > 0)
-            builder->space(1);
-          builder->node(m_rampload_core->get_by_percentage(load));
+    bool build(builder* builder, tag_t tag) const {
+      switch (tag) {
+        case tag_id(TAG_LABEL):
+          builder->node(m_label);
+          break;
+        case tag_id(TAG_BAR_LOAD):
+          builder->node(m_barload->output(m_total));
+          break;
+        case tag_id(TAG_RAMP_LOAD):
+          builder->node(m_rampload->get_by_percentage(m_total));
+          break;
+        case tag_id(TAG_RAMP_LOAD_PER_CORE): {
+          auto i = 0;
+          for (auto&& load : m_load) {
+            if (i++ > 0)
+              builder->space(1);
+            builder->node(m_rampload_core->get_by_percentage(load));
+          }
+          builder->node(builder->flush());
+          break;
         }
-        builder->node(builder->flush());
-      } else
-        return false;
+        default:
+          return false;
+      }
       return true;
     }
 
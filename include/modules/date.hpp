@@ -46,10 +46,10 @@ namespace modules {
       return m_builder->flush();
     }
 
-    bool build(builder* builder, string tag) const {
-      if (tag == TAG_DATE)
+    bool build(builder* builder, tag_t tag) const {
+      if (tag == tag_id(TAG_DATE))
         builder->node(m_buffer);
-      return tag == TAG_DATE;
+      return tag == tag_id(TAG_DATE);
     }
 
     bool handle_event(string cmd) {
@@ -60,8 +60,8 @@ namespace modules {
       return cmd == EVENT_TOGGLE;
     }
 
-    bool receive_events() const {
-      return true;
+    vector<string> event_prefixes() const {
+      return {EVENT_TOGGLE};
     }
 
    private:
@@ -191,10 +191,10 @@ namespace modules {
       // }}}
     }
 
-    bool build(builder* builder, string tag) const {
+    bool build(builder* builder, tag_t tag) const {
       // Output workspace info {{{
 
-      if (tag != TAG_LABEL_STATE)
+      if (tag != tag_id(TAG_LABEL_STATE))
         return false;
 
       for (auto&& ws : m_workspaces) {
@@ -237,8 +237,8 @@ namespace modules {
       // }}}
     }
 
-    bool receive_events() const {
-      return true;
+    vector<string> event_prefixes() const {
+      return {EVENT_PREFIX};
     }
 
    private:
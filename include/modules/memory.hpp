@@ -73,6 +73,8 @@ namespace modules {
         m_label->reset_tokens();
 
         auto replace_unit = [](label_t& label, string token, float value, string unit) {
+          if (!label->has_token(token))
+            return;
           auto formatted = string_util::from_stream(
               stringstream() << std::setprecision(2) << std::fixed << value << " " << unit);
           label->replace_token(token, formatted);
@@ -92,15 +94,20 @@ namespace modules {
       return true;
     }
 
-    bool build(builder* builder, string tag) const {
-      if (tag == TAG_BAR_USED)
-        builder->node(m_bars.at(memtype::USED)->output(m_perc.at(memtype::USED)));
-      else if (tag == TAG_BAR_FREE)
-        builder->node(m_bars.at(memtype::FREE)->output(m_perc.at(memtype::FREE)));
-      else if (tag == TAG_LABEL)
-        builder->node(m_label);
-      else
-        return false;
+    bool build(builder* builder, tag_t tag) const {
+      switch (tag) {
+        case tag_id(TAG_BAR_USED):
+          builder->node(m_bars.at(memtype::USED)->output(m_perc.at(memtype::USED)));
+          break;
+        case tag_id(TAG_BAR_FREE):
+          builder->node(m_bars.at(memtype::FREE)->output(m_perc.at(memtype::FREE)));
+          break;
+        case tag_id(TAG_LABEL):
+          builder->node(m_label);
+          break;
+        default:
+          return false;
+      }
       return true;
     }
 
@@ -58,33 +58,39 @@ namespace modules {
       }
     }
 
-    bool build(builder* builder, string tag) const {
-      if (tag == TAG_LABEL_TOGGLE && m_level == -1) {
-        builder->cmd(mousebtn::LEFT, string(EVENT_MENU_OPEN) + "0");
-        builder->node(m_labelopen);
-        builder->cmd_close(true);
-      } else if (tag == TAG_LABEL_TOGGLE && m_level > -1) {
-        builder->cmd(mousebtn::LEFT, EVENT_MENU_CLOSE);
-        builder->node(m_labelclose);
-        builder->cmd_close(true);
-      } else if (tag == TAG_MENU && m_level > -1) {
-        for (auto&& item : m_levels[m_level]->items) {
-          if (item != m_levels[m_level]->items.front())
-            builder->space();
-          if (*m_labelseparator)
-            builder->node(m_labelseparator, true);
-          builder->cmd(mousebtn::LEFT, item->exec);
-          builder->node(item->label);
+    bool build(builder* builder, tag_t tag) const {
+      switch (tag) {
+        case tag_id(TAG_LABEL_TOGGLE):
+          if (m_level == -1) {
+            builder->cmd(mousebtn::LEFT, string(EVENT_MENU_OPEN) + "0");
+            builder->node(m_labelopen);
+          } else {
+            builder->cmd(mousebtn::LEFT, EVENT_MENU_CLOSE);
+            builder->node(m_labelclose);
+          }
           builder->cmd_close(true);
-        }
-      } else {
-        return false;
+          break;
+        case tag_id(TAG_MENU):
+          if (m_level == -1)
+            return false;
+          for (auto&& item : m_levels[m_level]->items) {
+            if (item != m_levels[m_level]->items.front())
+              builder->space();
+            if (*m_labelseparator)
+              builder->node(m_labelseparator, true);
+            builder->cmd(mousebtn::LEFT, item->exec);
+            builder->node(item->label);
+            builder->cmd_close(true);
+          }
+          break;
+        default:
+          return false;
       }
       return true;
     }
 
     bool handle_event(string cmd) {
-      if (cmd.compare(0, 4, "menu") != 0)
+      if (cmd.compare(0, strlen(EVENT_PREFIX), EVENT_PREFIX) != 0)
         return false;
 
       // broadcast update when leaving leaving the function
@@ -122,14 +128,15 @@ namespace modules {
       return true;
     }
 
-    bool receive_events() const {
-      return true;
+    vector<string> event_prefixes() const {
+      return {EVENT_PREFIX};
     }
 
    private:
     static constexpr auto TAG_LABEL_TOGGLE = "<label-toggle>";
     static constexpr auto TAG_MENU = "<menu>";
 
+    static constexpr auto EVENT_PREFIX = "menu";
     static constexpr auto EVENT_MENU_OPEN = "menu-open-";
     static constexpr auto EVENT_MENU_CLOSE = "menu-close";
 
@@ -8,6 +8,7 @@
 #include "components/builder.hpp"
 #include "components/config.hpp"
 #include "components/logger.hpp"
+#include "utils/format.hpp"
 #include "utils/inotify.hpp"
 #include "utils/string.hpp"
 #include "utils/threading.hpp"
@@ -22,6 +23,8 @@ LEMONBUDDY_NS
 
 namespace modules {
   using namespace drawtypes;
+  using format_util::tag_t;
+  using format_util::tag_id;
 
   DEFINE_ERROR(module_error);
   DEFINE_CHILD_ERROR(undefined_format, module_error);
@@ -31,6 +34,7 @@ namespace modules {
 
   struct module_format {
     string value;
+    vector<format_util::chunk> chunks;
     vector<string> tags;
     string fg;
     string bg;
@@ -96,10 +100,12 @@ namespace modules {
       format->padding = m_conf.get<int>(m_modname, name + "-padding", 0);
       format->margin = m_conf.get<int>(m_modname, name + "-margin", 0);
       format->offset = m_conf.get<int>(m_modname, name + "-offset", 0);
+      format->chunks = format_util::compile(format->value);
       format->tags.swap(tags);
 
-      for (auto&& tag : string_util::split(format->value, ' ')) {
-        if (tag[0] != '<' || tag[tag.length() - 1] != '>')
+      for (auto&& chunk : format->chunks) {
+        auto& tag = chunk.text;
+        if (chunk.tag == 0)
           continue;
         if (std::find(format->tags.begin(), format->tags.end(), tag) != format->tags.end())
           continue;
@@ -148,15 +154,18 @@ namespace modules {
 
     virtual string name() const = 0;
     virtual bool running() const = 0;
+    virtual bool ready() const = 0;
 
     virtual void setup() = 0;
     virtual void start() = 0;
     virtual void stop() = 0;
     virtual void halt(string error_message) = 0;
-    virtual string contents() = 0;
+    virtual void suspend(bool state) = 0;
+    virtual void restore(string contents) = 0;
+    virtual shared_ptr<const string> contents() = 0;
 
     virtual bool handle_event(string cmd) = 0;
-    virtual bool receive_events() const = 0;
+    virtual vector<string> event_prefixes() const = 0;
 
     virtual void set_writer(std::function<void(string)>&& fn) = 0;
     virtual void set_terminator(std::function<void(string)>&& fn) = 0;
@@ -174,14 +183,28 @@ namespace modules {
         , m_conf(config)
         , m_name("module/" + name)
         , m_builder(make_unique<builder>(bar))
-        , m_formatter(make_unique<module_formatter>(m_conf, m_name)) {}
+        , m_formatter(make_unique<module_formatter>(m_conf, m_name)) {
+      m_minwidth = m_conf.get<int>(m_name, "min-width", 0);
+      m_maxwidth = m_conf.get<int>(m_name, "fixed-width", 0);
+      m_ellipsis = m_conf.get<string>(m_name, "overflow", "clip") == "ellipsis";
+
+      if (m_maxwidth > 0)
+        m_minwidth = m_maxwidth;
+
+      // Shown until the module has produced its first output
+      m_cache.store(m_conf.get<string>(m_name, "placeholder", "..."));
+
+#ifdef DEBUG
+      m_updatelock.set_metrics(&m_lockmetrics);
+#endif
+    }
 
     ~module() {
       CAST_MOD(Impl)->stop();
 
       m_updatelock.unlock();
 
-      std::lock_guard<threading_util::spin_lock> lck(m_updatelock);
+      std::lock_guard<threading_util::adaptive_lock> lck(m_updatelock);
       {
         if (m_broadcast_thread.joinable())
           m_broadcast_thread.join();
@@ -194,6 +217,13 @@ namespace modules {
         m_threads.clear();
       }
 
+#ifdef DEBUG
+      m_log.trace("%s: Update lock taken %lu times, %lu contended (%lu spins, %lu parks, %lums)",
+          name(), m_lockmetrics.acquisitions.load(), m_lockmetrics.contended.load(),
+          m_lockmetrics.spins.load(), m_lockmetrics.parks.load(),
+          m_lockmetrics.parked_ns.load() / 1000000);
+#endif
+
       m_log.trace("%s: Done cleaning up", name());
     }
 
@@ -213,6 +243,10 @@ namespace modules {
       return CONST_MOD(Impl).enabled();
     }
 
+    bool ready() const {
+      return m_ready || m_restored || !CONST_MOD(Impl).enabled();
+    }
+
     void setup() {
       m_log.trace("%s: Setup", name());
 
@@ -231,11 +265,15 @@ namespace modules {
       if (!enabled())
         return;
 
-      std::unique_lock<threading_util::spin_lock> lck(m_updatelock);
+      std::unique_lock<threading_util::adaptive_lock> lck(m_updatelock);
       {
         enable(false);
         CAST_MOD(Impl)->teardown();
         m_log.trace("%s: Stop", name());
+
+        // Drop the placeholder if the module never produced any output
+        if (!m_ready)
+          m_cache.store("");
       }
 
       if (m_terminator)
@@ -252,16 +290,37 @@ namespace modules {
       CAST_MOD(Impl)->wakeup();
     }
 
-    string contents() {
-      return m_cache;
+    /**
+     * Pause periodic updates while the bar can't be seen
+     */
+    void suspend(bool state) {
+      {
+        std::lock_guard<std::mutex> lck(m_sleeplock);
+        m_suspended = state;
+      }
+      m_sleephandler.notify_all();
+    }
+
+    /**
+     * Show the output of a previous run until the module produces its own
+     */
+    void restore(string contents) {
+      if (m_ready || contents.empty())
+        return;
+      m_cache.store(move(contents));
+      m_restored = true;
+    }
+
+    shared_ptr<const string> contents() {
+      return m_cache.load();
     }
 
     bool handle_event(string cmd) {
       return CAST_MOD(Impl)->handle_event(cmd);
     }
 
-    bool receive_events() const {
-      return false;
+    vector<string> event_prefixes() const {
+      return {};
     }
 
    protected:
@@ -277,7 +336,8 @@ namespace modules {
       if (!enabled())
         return;
 
-      m_cache = CAST_MOD(Impl)->get_output();
+      m_cache.store(CAST_MOD(Impl)->get_output());
+      m_ready = true;
 
       if (m_writer)
         m_writer(name());
@@ -292,6 +352,15 @@ namespace modules {
       m_sleephandler.wait_for(lck, sleep_duration);
     }
 
+    /**
+     * Block until the module is resumed, but at most for the given duration
+     */
+    void sleep_suspended(chrono::duration<double> max_duration) {
+      std::unique_lock<std::mutex> lck(m_sleeplock);
+      m_sleephandler.wait_for(
+          lck, max_duration, [this] { return !m_suspended || !CONST_MOD(Impl).enabled(); });
+    }
+
     void wakeup() {
       m_log.trace("%s: Release sleep lock", name());
       // std::unique_lock<std::mutex> lck(m_sleeplock);
@@ -314,31 +383,43 @@ namespace modules {
       int i = 0;
       bool tag_built = true;
 
-      for (auto tag : string_util::split(format->value, ' ')) {
-        bool is_blankspace = tag.empty();
+      for (auto&& chunk : format->chunks) {
+        bool is_blankspace = chunk.text.empty();
 
-        if (tag[0] == '<' && tag[tag.length() - 1] == '>') {
+        if (chunk.tag != 0) {
           if (i > 0)
             m_builder->space(format->spacing);
-          if (!(tag_built = CONST_MOD(Impl).build(m_builder.get(), tag)) && i > 0)
+          if (!(tag_built = CONST_MOD(Impl).build(m_builder.get(), chunk.tag)) && i > 0)
             m_builder->remove_trailing_space(format->spacing);
           if (tag_built)
             i++;
         } else if (is_blankspace && tag_built) {
           m_builder->node(" ");
         } else if (!is_blankspace) {
-          m_builder->node(tag);
+          m_builder->node(chunk.text);
         }
       }
 
-      return format->decorate(m_builder.get(), m_builder->flush());
+      auto output = format->decorate(m_builder.get(), m_builder->flush());
+
+      if (output.empty() || m_minwidth <= 0)
+        return output;
+
+      // Reserve a slot of stable width for the output
+      m_builder->slot(m_minwidth, m_maxwidth, m_ellipsis);
+      m_builder->append(output);
+
+      return m_builder->flush();
     }
 
    protected:
     function<void(string)> m_writer;
     function<void(string)> m_terminator;
 
-    threading_util::spin_lock m_updatelock;
+    threading_util::adaptive_lock m_updatelock;
+#ifdef DEBUG
+    threading_util::lock_metrics m_lockmetrics;
+#endif
     // std::timed_mutex m_mutex;
 
     const bar_settings m_bar;
@@ -353,9 +434,16 @@ namespace modules {
     unique_ptr<module_formatter> m_formatter;
     vector<thread> m_threads;
 
+    int m_minwidth{0};
+    int m_maxwidth{0};
+    bool m_ellipsis{false};
+    stateflag m_suspended{false};
+
    private:
     stateflag m_enabled{false};
-    string m_cache;
+    stateflag m_ready{false};
+    stateflag m_restored{false};
+    threading_util::publisher<string> m_cache;
     thread m_broadcast_thread;
   };
 
@@ -374,7 +462,7 @@ namespace modules {
       CAST_MOD(Impl)->broadcast();
     }
 
-    bool build(builder*, string) const {
+    bool build(builder*, tag_t) const {
       return true;
     }
   };
@@ -402,8 +490,13 @@ namespace modules {
         CAST_MOD(Impl)->setup();
 
         while (CONST_MOD(Impl).enabled()) {
+          if (this->m_suspended) {
+            // Stretch the interval instead of blocking indefinitely
+            CAST_MOD(Impl)->sleep_suspended(m_interval * 10);
+            continue;
+          }
           {
-            std::lock_guard<threading_util::spin_lock> lck(this->m_updatelock);
+            std::lock_guard<threading_util::adaptive_lock> lck(this->m_updatelock);
             if (CAST_MOD(Impl)->update())
               CAST_MOD(Impl)->broadcast();
           }
@@ -440,7 +533,7 @@ namespace modules {
         CAST_MOD(Impl)->broadcast();
 
         while (CONST_MOD(Impl).enabled()) {
-          std::lock_guard<threading_util::spin_lock> lck(this->m_updatelock);
+          std::lock_guard<threading_util::adaptive_lock> lck(this->m_updatelock);
 
           if (!CAST_MOD(Impl)->has_event())
             CAST_MOD(Impl)->idle();
@@ -470,6 +563,17 @@ namespace modules {
       CAST_MOD(Impl)->m_threads.emplace_back(thread(&inotify_module::runner, this));
     }
 
+    /**
+     * Wake up the runner waiting for inotify events
+     */
+    void teardown() {
+      {
+        std::lock_guard<std::mutex> lck(m_eventlock);
+      }
+      m_eventcond.notify_all();
+      module<Impl>::teardown();
+    }
+
    protected:
     void runner() {
       try {
@@ -477,6 +581,8 @@ namespace modules {
         CAST_MOD(Impl)->on_event(nullptr);  // warmup
         CAST_MOD(Impl)->broadcast();
 
+        auto watches = attach_watches();
+
         while (CAST_MOD(Impl)->enabled()) {
           CAST_MOD(Impl)->poll_events();
         }
@@ -496,44 +602,89 @@ namespace modules {
       CAST_MOD(Impl)->sleep(200ms);
     }
 
-    void poll_events() {
-      vector<unique_ptr<inotify_watch>> watches;
+    /**
+     * Attach the watches to the shared inotify service, they stay
+     * attached until the runner returns
+     */
+    vector<inotify_watch_t> attach_watches() {
+      vector<inotify_watch_t> watches;
 
-      try {
-        for (auto&& w : m_watchlist) {
-          watches.emplace_back(inotify_util::make_watch(w.first));
-          watches.back()->attach(w.second);
+      while (CONST_MOD(Impl).enabled()) {
+        try {
+          for (auto&& w : m_watchlist) {
+            watches.emplace_back(inotify_util::make_watch(w.first));
+            watches.back()->attach(
+                w.second, [this](const inotify_event& event) { on_inotify_event(event); });
+          }
+          break;
+        } catch (const system_error& e) {
+          watches.clear();
+          this->m_log.err("%s: Error while creating inotify watch (what: %s)",
+              CONST_MOD(Impl).name(), e.what());
+          CAST_MOD(Impl)->sleep(0.1s);
         }
-      } catch (const system_error& e) {
-        watches.clear();
-        this->m_log.err(
-            "%s: Error while creating inotify watch (what: %s)", CONST_MOD(Impl).name(), e.what());
-        CAST_MOD(Impl)->sleep(0.1s);
-        return;
       }
 
-      while (CONST_MOD(Impl).enabled()) {
-        for (auto&& w : watches) {
-          this->m_log.trace_x("%s: Poll inotify watch %s", CONST_MOD(Impl).name(), w->path());
-          std::lock_guard<threading_util::spin_lock> lck(this->m_updatelock);
+      return watches;
+    }
 
-          if (w->poll(1000 / watches.size())) {
-            auto event = w->get_event();
+    /**
+     * Called from the inotify service thread
+     */
+    void on_inotify_event(const inotify_event& event) {
+      std::lock_guard<std::mutex> lck(m_eventlock);
 
-            w->remove();
+      if (m_pending) {
+        m_event.mask |= event.mask;
+      } else {
+        m_event = event;
+        m_pending = true;
+      }
 
-            if (CAST_MOD(Impl)->on_event(event.get()))
-              CAST_MOD(Impl)->broadcast();
+      m_eventcond.notify_all();
+    }
 
-            return;
-          }
-        }
-        CAST_MOD(Impl)->idle();
+    void poll_events() {
+      inotify_event event;
+
+      {
+        std::unique_lock<std::mutex> lck(m_eventlock);
+        m_eventcond.wait(lck, [this] { return m_pending || !CONST_MOD(Impl).enabled(); });
+
+        if (!m_pending)
+          return;
+
+        event = m_event;
+        m_pending = false;
+      }
+
+      {
+        std::lock_guard<threading_util::adaptive_lock> lck(this->m_updatelock);
+
+        if (CAST_MOD(Impl)->on_event(&event))
+          CAST_MOD(Impl)->broadcast();
       }
+
+      // Drop the events caused by on_event() reading the watched files,
+      // but keep any change that was made to them in the meantime
+      inotify_service::instance().sync();
+
+      {
+        std::lock_guard<std::mutex> lck(m_eventlock);
+        if (m_pending && (m_event.mask = inotify_util::strip_reads(m_event.mask)) == 0)
+          m_pending = false;
+      }
+
+      CAST_MOD(Impl)->idle();
     }
 
    private:
     map<string, int> m_watchlist;
+
+    std::mutex m_eventlock;
+    std::condition_variable m_eventcond;
+    inotify_event m_event;
+    bool m_pending{false};
   };
 
   // }}}
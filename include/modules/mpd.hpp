@@ -206,7 +206,7 @@ namespace modules {
       return connected() ? FORMAT_ONLINE : FORMAT_OFFLINE;
     }
 
-    bool build(builder* builder, string tag) const {
+    bool build(builder* builder, tag_t tag) const {
       bool is_playing = false;
       bool is_paused = false;
       bool is_stopped = true;
@@ -229,41 +229,75 @@ namespace modules {
         builder->cmd_close();
       };
 
-      if (tag == TAG_LABEL_SONG && !is_stopped)
-        builder->node(m_label_song);
-      else if (tag == TAG_LABEL_TIME && !is_stopped)
-        builder->node(m_label_time);
-      else if (tag == TAG_BAR_PROGRESS && !is_stopped)
-        builder->node(m_bar_progress->output(elapsed_percentage));
-      else if (tag == TAG_LABEL_OFFLINE)
-        builder->node(m_label_offline);
-      else if (tag == TAG_ICON_RANDOM)
-        icon_cmd(EVENT_RANDOM, m_icons->get("random"));
-      else if (tag == TAG_ICON_REPEAT)
-        icon_cmd(EVENT_REPEAT, m_icons->get("repeat"));
-      else if (tag == TAG_ICON_REPEAT_ONE)
-        icon_cmd(EVENT_REPEAT_ONE, m_icons->get("repeat_one"));
-      else if (tag == TAG_ICON_PREV)
-        icon_cmd(EVENT_PREV, m_icons->get("prev"));
-      else if (tag == TAG_ICON_STOP && (is_playing || is_paused))
-        icon_cmd(EVENT_STOP, m_icons->get("stop"));
-      else if ((tag == TAG_ICON_PAUSE || tag == TAG_TOGGLE) && is_playing)
-        icon_cmd(EVENT_PAUSE, m_icons->get("pause"));
-      else if ((tag == TAG_ICON_PLAY || tag == TAG_TOGGLE) && !is_playing)
-        icon_cmd(EVENT_PLAY, m_icons->get("play"));
-      else if (tag == TAG_ICON_NEXT)
-        icon_cmd(EVENT_NEXT, m_icons->get("next"));
-      else if (tag == TAG_ICON_SEEKB)
-        icon_cmd(string(EVENT_SEEK).append("-5"), m_icons->get("seekb"));
-      else if (tag == TAG_ICON_SEEKF)
-        icon_cmd(string(EVENT_SEEK).append("+5"), m_icons->get("seekf"));
-      else
-        return false;
+      switch (tag) {
+        case tag_id(TAG_LABEL_SONG):
+          if (is_stopped)
+            return false;
+          builder->node(m_label_song);
+          break;
+        case tag_id(TAG_LABEL_TIME):
+          if (is_stopped)
+            return false;
+          builder->node(m_label_time);
+          break;
+        case tag_id(TAG_BAR_PROGRESS):
+          if (is_stopped)
+            return false;
+          builder->node(m_bar_progress->output(elapsed_percentage));
+          break;
+        case tag_id(TAG_LABEL_OFFLINE):
+          builder->node(m_label_offline);
+          break;
+        case tag_id(TAG_ICON_RANDOM):
+          icon_cmd(EVENT_RANDOM, m_icons->get("random"));
+          break;
+        case tag_id(TAG_ICON_REPEAT):
+          icon_cmd(EVENT_REPEAT, m_icons->get("repeat"));
+          break;
+        case tag_id(TAG_ICON_REPEAT_ONE):
+          icon_cmd(EVENT_REPEAT_ONE, m_icons->get("repeat_one"));
+          break;
+        case tag_id(TAG_ICON_PREV):
+          icon_cmd(EVENT_PREV, m_icons->get("prev"));
+          break;
+        case tag_id(TAG_ICON_STOP):
+          if (!is_playing && !is_paused)
+            return false;
+          icon_cmd(EVENT_STOP, m_icons->get("stop"));
+          break;
+        case tag_id(TAG_ICON_PAUSE):
+          if (!is_playing)
+            return false;
+          icon_cmd(EVENT_PAUSE, m_icons->get("pause"));
+          break;
+        case tag_id(TAG_ICON_PLAY):
+          if (is_playing)
+            return false;
+          icon_cmd(EVENT_PLAY, m_icons->get("play"));
+          break;
+        case tag_id(TAG_TOGGLE):
+          if (is_playing)
+            icon_cmd(EVENT_PAUSE, m_icons->get("pause"));
+          else
+            icon_cmd(EVENT_PLAY, m_icons->get("play"));
+          break;
+        case tag_id(TAG_ICON_NEXT):
+          icon_cmd(EVENT_NEXT, m_icons->get("next"));
+          break;
+        case tag_id(TAG_ICON_SEEKB):
+          icon_cmd(string(EVENT_SEEK).append("-5"), m_icons->get("seekb"));
+          break;
+        case tag_id(TAG_ICON_SEEKF):
+          icon_cmd(string(EVENT_SEEK).append("+5"), m_icons->get("seekf"));
+          break;
+        default:
+          return false;
+      }
       return true;
     }
 
     bool handle_event(string cmd) {
-      if (cmd.compare(0, 3, "mpd") != 0)
+      if (cmd.compare(0, strlen(EVENT_PREFIX), EVENT_PREFIX) != 0)
         return false;
 
       try {
@@ -311,8 +345,8 @@ namespace modules {
       return true;
     }
 
-    bool receive_events() const {
-      return true;
+    vector<string> event_prefixes() const {
+      return {EVENT_PREFIX};
     }
 
    private:
@@ -338,6 +372,7 @@ namespace modules {
     static constexpr auto FORMAT_OFFLINE = "format-offline";
     static constexpr auto TAG_LABEL_OFFLINE = "<label-offline>";
 
+    static constexpr auto EVENT_PREFIX = "mpd";
     static constexpr auto EVENT_PLAY = "mpdplay";
     static constexpr auto EVENT_PAUSE = "mpdpause";
     static constexpr auto EVENT_STOP = "mpdstop";
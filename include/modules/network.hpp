@@ -108,18 +108,21 @@ namespace modules {
       auto upspeed = network->upspeed(m_udspeed_minwidth);
       auto downspeed = network->downspeed(m_udspeed_minwidth);
 
-      // Update label contents
+      // Update label contents, skipping the queries for tokens the label doesn't use
       const auto replace_tokens = [&](label_t& label) {
         label->reset_tokens();
         label->replace_token("%ifname%", m_interface);
-        label->replace_token("%local_ip%", network->ip());
+        if (label->has_token("%local_ip%"))
+          label->replace_token("%local_ip%", network->ip());
         label->replace_token("%upspeed%", upspeed);
         label->replace_token("%downspeed%", downspeed);
 
         if (m_wired) {
-          label->replace_token("%linkspeed%", m_wired->linkspeed());
+          if (label->has_token("%linkspeed%"))
+            label->replace_token("%linkspeed%", m_wired->linkspeed());
         } else if (m_wireless) {
-          label->replace_token("%essid%", m_wireless->essid());
+          if (label->has_token("%essid%"))
+            label->replace_token("%essid%", m_wireless->essid());
           label->replace_token("%signal%", to_string(m_signal) + "%");
           label->replace_token("%quality%", to_string(m_quality) + "%");
         }
@@ -142,21 +145,29 @@ namespace modules {
         return FORMAT_CONNECTED;
     }
 
-    bool build(builder* builder, string tag) const {
-      if (tag == TAG_LABEL_CONNECTED)
-        builder->node(m_label.at(connection_state::CONNECTED));
-      else if (tag == TAG_LABEL_DISCONNECTED)
-        builder->node(m_label.at(connection_state::DISCONNECTED));
-      else if (tag == TAG_LABEL_PACKETLOSS)
-        builder->node(m_label.at(connection_state::PACKETLOSS));
-      else if (tag == TAG_ANIMATION_PACKETLOSS)
-        builder->node(m_animation_packetloss->get());
-      else if (tag == TAG_RAMP_SIGNAL)
-        builder->node(m_ramp_signal->get_by_percentage(m_signal));
-      else if (tag == TAG_RAMP_QUALITY)
-        builder->node(m_ramp_quality->get_by_percentage(m_quality));
-      else
-        return false;
+    bool build(builder* builder, tag_t tag) const {
+      switch (tag) {
+        case tag_id(TAG_LABEL_CONNECTED):
+          builder->node(m_label.at(connection_state::CONNECTED));
+          break;
+        case tag_id(TAG_LABEL_DISCONNECTED):
+          builder->node(m_label.at(connection_state::DISCONNECTED));
+          break;
+        case tag_id(TAG_LABEL_PACKETLOSS):
+          builder->node(m_label.at(connection_state::PACKETLOSS));
+          break;
+        case tag_id(TAG_ANIMATION_PACKETLOSS):
+          builder->node(m_animation_packetloss->get());
+          break;
+        case tag_id(TAG_RAMP_SIGNAL):
+          builder->node(m_ramp_signal->get_by_percentage(m_signal));
+          break;
+        case tag_id(TAG_RAMP_QUALITY):
+          builder->node(m_ramp_quality->get_by_percentage(m_quality));
+          break;
+        default:
+          return false;
+      }
       return true;
     }
 
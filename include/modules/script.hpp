@@ -38,7 +38,7 @@ namespace modules {
       wakeup();
       enable(false);
       m_command.reset();
-      std::lock_guard<threading_util::spin_lock> lck(m_updatelock);
+      std::lock_guard<threading_util::adaptive_lock> lck(m_updatelock);
       wakeup();
     }
 
@@ -129,8 +129,8 @@ namespace modules {
       return m_builder->flush();
     }
 
-    bool build(builder* builder, string tag) const {
-      if (tag == TAG_OUTPUT) {
+    bool build(builder* builder, tag_t tag) const {
+      if (tag == tag_id(TAG_OUTPUT)) {
         builder->node(m_output);
         return true;
       } else {
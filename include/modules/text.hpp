@@ -15,8 +15,9 @@ namespace modules {
       if (m_formatter->get("content")->value.empty())
         throw module_error(name() + ".content is empty or undefined");
 
-      m_formatter->get("content")->value =
-          string_util::replace_all(m_formatter->get("content")->value, " ", BUILDER_SPACE_TOKEN);
+      auto content = m_formatter->get("content");
+      content->value = string_util::replace_all(content->value, " ", BUILDER_SPACE_TOKEN);
+      content->chunks = format_util::compile(content->value);
     }
 
     string get_format() const {
@@ -65,6 +65,7 @@ namespace modules {
       m_connection.attach_sink(this, 1);
       m_connection.select_input_checked(
           m_connection.screen()->root, XCB_RANDR_NOTIFY_MASK_OUTPUT_PROPERTY);
+      m_connection.count_roundtrip();
 
       // Create a throttle so that we limit the amount of events
       // to handle since randr can burst out quite a few
@@ -127,15 +128,20 @@ namespace modules {
     /**
      * Output content as defined in the config
      */
-    bool build(builder* builder, string tag) const {
-      if (tag == TAG_BAR)
-        builder->node(m_progressbar->output(m_percentage));
-      else if (tag == TAG_RAMP)
-        builder->node(m_ramp->get_by_percentage(m_percentage));
-      else if (tag == TAG_LABEL)
-        builder->node(m_label);
-      else
-        return false;
+    bool build(builder* builder, tag_t tag) const {
+      switch (tag) {
+        case tag_id(TAG_BAR):
+          builder->node(m_progressbar->output(m_percentage));
+          break;
+        case tag_id(TAG_RAMP):
+          builder->node(m_ramp->get_by_percentage(m_percentage));
+          break;
+        case tag_id(TAG_LABEL):
+          builder->node(m_label);
+          break;
+        default:
+          return false;
+      }
       return true;
     }
 
@@ -31,22 +31,29 @@ namespace bspwm_util {
    */
   auto root_windows(connection& conn) {
     vector<xcb_window_t> roots;
-    auto children = conn.query_tree(conn.screen()->root).children();
+    auto tree = conn.query_tree(conn.screen()->root);
+    vector<xcb_window_t> children{tree.children().begin(), tree.children().end()};
 
-    for (auto it = children.begin(); it != children.end(); it++) {
-      auto cookie = xcb_icccm_get_wm_class(conn, *it);
+    // Request the class of all windows before waiting for the first reply
+    vector<xcb_get_property_cookie_t> cookies;
+    for (auto&& child : children) cookies.emplace_back(xcb_icccm_get_wm_class(conn, child));
+
+    for (size_t i = 0; i < children.size(); i++) {
       xcb_icccm_get_wm_class_reply_t reply;
 
-      if (xcb_icccm_get_wm_class_reply(conn, cookie, &reply, nullptr) == 0)
+      if (xcb_icccm_get_wm_class_reply(conn, cookies[i], &reply, nullptr) == 0)
         continue;
 
-      if (!string_util::compare("Bspwm", reply.class_name) ||
-          !string_util::compare("root", reply.instance_name))
-        continue;
+      bool match = string_util::compare("Bspwm", reply.class_name) &&
+                   string_util::compare("root", reply.instance_name);
+      xcb_icccm_get_wm_class_reply_wipe(&reply);
 
-      roots.emplace_back(*it);
+      if (match)
+        roots.emplace_back(children[i]);
     }
 
+    conn.count_roundtrip(2);
+
     return roots;
   }
 
@@ -57,8 +64,16 @@ namespace bspwm_util {
    * Fixes the issue with always-on-top window's
    */
   bool restack_above_root(connection& conn, const monitor_t& mon, const xcb_window_t win) {
-    for (auto&& root : root_windows(conn)) {
-      auto geom = conn.get_geometry(root);
+    auto roots = root_windows(conn);
+
+    vector<decltype(conn.get_geometry(0))> geometries;
+    for (auto&& root : roots) geometries.emplace_back(conn.get_geometry(root));
+
+    if (!roots.empty())
+      conn.count_roundtrip();
+
+    for (size_t i = 0; i < roots.size(); i++) {
+      auto& geom = geometries[i];
 
       if (mon->x != geom->x || mon->y != geom->y)
         continue;
@@ -66,10 +81,11 @@ namespace bspwm_util {
         continue;
 
       const uint32_t value_mask = XCB_CONFIG_WINDOW_SIBLING | XCB_CONFIG_WINDOW_STACK_MODE;
-      const uint32_t value_list[2]{root, XCB_STACK_MODE_ABOVE};
+      const uint32_t value_list[2]{roots[i], XCB_STACK_MODE_ABOVE};
 
       conn.configure_window_checked(win, value_mask, value_list);
       conn.flush();
+      conn.count_roundtrip();
 
       return true;
     }
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+
+#include "common.hpp"
+
+LEMONBUDDY_NS
+
+namespace cache_util {
+  /**
+   * Bounded cache that evicts the least recently used entry
+   */
+  template <typename Key, typename Value, typename Hash = std::hash<Key>>
+  class lru_cache {
+   public:
+    using entry_t = std::pair<Key, Value>;
+
+    explicit lru_cache(size_t capacity) : m_capacity(capacity) {}
+
+    /**
+     * Get cached value and mark it as most recently used
+     *
+     * @return nullptr if the key isn't cached
+     */
+    const Value* find(const Key& key) {
+      auto it = m_index.find(key);
+
+      if (it == m_index.end()) {
+        m_misses++;
+        return nullptr;
+      }
+
+      m_entries.splice(m_entries.begin(), m_entries, it->second);
+      m_hits++;
+
+      return &it->second->second;
+    }
+
+    /**
+     * Cache value, evicting the least recently used entry when full
+     */
+    const Value& insert(const Key& key, Value value) {
+      auto it = m_index.find(key);
+
+      if (it != m_index.end()) {
+        it->second->second = move(value);
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return it->second->second;
+      }
+
+      if (m_capacity > 0 && m_entries.size() >= m_capacity) {
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+      }
+
+      m_entries.emplace_front(key, move(value));
+      m_index.emplace(key, m_entries.begin());
+
+      return m_entries.front().second;
+    }
+
+    void clear() {
+      m_index.clear();
+      m_entries.clear();
+    }
+
+    size_t size() const {
+      return m_entries.size();
+    }
+
+    size_t hits() const {
+      return m_hits;
+    }
+
+    size_t misses() const {
+      return m_misses;
+    }
+
+    /**
+     * Get the percentage of lookups that were cache hits
+     */
+    float hit_rate() const {
+      if (m_hits + m_misses == 0)
+        return 0.0f;
+      return 100.0f * m_hits / (m_hits + m_misses);
+    }
+
+    void reset_stats() {
+      m_hits = 0;
+      m_misses = 0;
+    }
+
+   private:
+    size_t m_capacity;
+    size_t m_hits{0};
+    size_t m_misses{0};
+    std::list<entry_t> m_entries;
+    std::unordered_map<Key, typename std::list<entry_t>::iterator, Hash> m_index;
+  };
+}
+
+LEMONBUDDY_NS_END
@@ -1,6 +1,12 @@
 #pragma once
 
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <deque>
 #include <functional>
+#include <list>
 #include <memory>
 #include <mutex>
 #include <stdexcept>
@@ -171,7 +177,7 @@ namespace command_util {
      * Write line to command input channel
      */
     int writeline(string data) {
-      std::lock_guard<threading_util::spin_lock> lck(m_pipelock);
+      std::lock_guard<threading_util::adaptive_lock> lck(m_pipelock);
       return io_util::writeline(m_stdin[PIPE_WRITE], data);
     }
 
@@ -179,7 +185,7 @@ namespace command_util {
      * Read a line from the commands output stream
      */
     string readline() {
-      std::lock_guard<threading_util::spin_lock> lck(m_pipelock);
+      std::lock_guard<threading_util::adaptive_lock> lck(m_pipelock);
       return io_util::readline(m_stdout[PIPE_READ]);
     }
 
@@ -231,7 +237,7 @@ namespace command_util {
     pid_t m_forkpid;
     int m_forkstatus;
 
-    threading_util::spin_lock m_pipelock;
+    threading_util::adaptive_lock m_pipelock;
   };
 
   using command_t = unique_ptr<command>;
@@ -241,6 +247,338 @@ namespace command_util {
     return make_unique<command>(
         configure_logger().create<const logger&>(), forward<Args>(args)...);
   }
+  /**
+   * What to do with a command that is already running at its limit
+   */
+  enum class repeat_policy { DROP = 0, QUEUE };
+
+  /**
+   * Executes commands in the background
+   *
+   * A dedicated thread spawns the commands, forwards their output
+   * line by line and reaps them once they exit, which means that
+   * the caller never blocks on a child process.
+   *
+   * At most `limit` instances of the same command are allowed to
+   * run at once. Repeats beyond that are dropped or queued until
+   * a running instance exits, depending on the policy.
+   *
+   * Example usage:
+   *
+   * @code cpp
+   *   auto runner = command_util::make_runner(1, command_util::repeat_policy::DROP);
+   *   runner->run("/usr/bin/env\nsh\n-c\nrofi -show run");
+   * @endcode
+   */
+  class runner : public non_copyable_mixin<runner> {
+   public:
+    using callback_t = function<void(string)>;
+
+    explicit runner(
+        const logger& logger, size_t limit = 1, repeat_policy policy = repeat_policy::DROP)
+        : m_log(logger), m_limit(limit > 0 ? limit : 1), m_policy(policy) {
+      if (pipe2(m_wakeup, O_CLOEXEC | O_NONBLOCK) != 0)
+        throw command_strerror("Failed to allocate wakeup channel");
+
+      m_thread = thread(&runner::loop, this);
+    }
+
+    /**
+     * Stop the spawner thread
+     *
+     * Commands that are still running are left alone and
+     * pending commands are discarded
+     */
+    ~runner() {
+      m_running = false;
+      wakeup();
+
+      if (m_thread.joinable())
+        m_thread.join();
+
+      for (auto&& job : m_jobs) close_job(job);
+
+      close(m_wakeup[PIPE_READ]);
+      close(m_wakeup[PIPE_WRITE]);
+    }
+
+    /**
+     * Schedule the command for execution
+     *
+     * @param callback Receives each line of output, the output is discarded if not set
+     * @return false if the command was dropped
+     */
+    bool run(string cmd, callback_t callback = nullptr) {
+      std::lock_guard<std::mutex> guard(m_mtx);
+
+      if (m_active[cmd] >= m_limit) {
+        if (m_policy == repeat_policy::DROP) {
+          m_log.trace("runner: Dropping repeated command (%s)", cmd);
+          return false;
+        }
+        m_log.trace("runner: Queueing repeated command (%s)", cmd);
+        m_waiting.emplace_back(cmd, callback);
+        return true;
+      }
+
+      m_active[cmd]++;
+      m_queue.emplace_back(cmd, callback);
+      wakeup();
+
+      return true;
+    }
+
+    /**
+     * Check if no commands are running or waiting to be run
+     */
+    bool idle() {
+      std::lock_guard<std::mutex> guard(m_mtx);
+      return m_active.empty();
+    }
+
+   protected:
+    struct job {
+      explicit job(string cmd, callback_t callback) : cmd(cmd), callback(callback) {}
+
+      string cmd;
+      callback_t callback;
+      pid_t pid{-1};
+      int output{-1};
+      int pidfd{-1};
+      string buffer;
+    };
+
+    void wakeup() {
+      char c{0};
+      if (::write(m_wakeup[PIPE_WRITE], &c, 1) == -1 && errno != EAGAIN)
+        m_log.warn("runner: Failed to wake spawner thread (%s)", strerror(errno));
+    }
+
+    /**
+     * Spawner thread
+     *
+     * Children are watched through pidfd's when supported by the kernel,
+     * otherwise they are polled for every REAP_INTERVAL_MS
+     */
+    void loop() {
+      vector<struct pollfd> fds;
+
+      while (m_running) {
+        bool polling{false};
+
+        fds.clear();
+        fds.push_back({m_wakeup[PIPE_READ], POLLIN, 0});
+
+        for (auto&& job : m_jobs) {
+          if (job.output != -1)
+            fds.push_back({job.output, POLLIN, 0});
+          if (job.pidfd != -1)
+            fds.push_back({job.pidfd, POLLIN, 0});
+          else
+            polling = true;
+        }
+
+        int timeout{polling ? REAP_INTERVAL_MS : -1};
+
+        if (::poll(fds.data(), fds.size(), timeout) == -1 && errno != EINTR) {
+          m_log.err("runner: Failed to poll children (%s)", strerror(errno));
+          break;
+        }
+
+        char buf[64];
+        while (::read(m_wakeup[PIPE_READ], buf, sizeof(buf)) > 0) {
+        }
+
+        for (auto&& job : m_jobs) read_output(job);
+
+        reap();
+        spawn();
+      }
+    }
+
+    /**
+     * Start all scheduled commands
+     */
+    void spawn() {
+      std::deque<job> queue;
+
+      {
+        std::lock_guard<std::mutex> guard(m_mtx);
+        std::swap(queue, m_queue);
+      }
+
+      for (auto&& job : queue) {
+        try {
+          start(job);
+          m_jobs.emplace_back(move(job));
+        } catch (const application_error& err) {
+          m_log.err("runner: %s (%s)", err.what(), job.cmd);
+          release(job.cmd);
+        }
+      }
+    }
+
+    void start(job& job) {
+      int output[2]{-1, -1};
+
+      if (job.callback && pipe2(output, O_CLOEXEC) != 0)
+        throw command_strerror("Failed to allocate output stream");
+
+      // Prepare the arguments before forking
+      vector<string> args;
+      vector<char*> argv;
+      string_util::split_into(job.cmd, string_util::contains(job.cmd, "\n") ? '\n' : ' ', args);
+      for (auto&& arg : args) argv.emplace_back(const_cast<char*>(arg.c_str()));
+      argv.emplace_back(nullptr);
+
+      if ((job.pid = fork()) == -1) {
+        if (job.callback) {
+          close(output[PIPE_READ]);
+          close(output[PIPE_WRITE]);
+        }
+        throw command_strerror("Failed to fork process");
+      }
+
+      if (process_util::in_forked_process(job.pid)) {
+        int null = open("/dev/null", O_RDWR);
+        int out = job.callback ? output[PIPE_WRITE] : null;
+
+        dup2(null, STDIN_FILENO);
+        dup2(out, STDOUT_FILENO);
+        dup2(out, STDERR_FILENO);
+
+        // Don't pass on the signals blocked by the controller
+        sigset_t sigmask;
+        sigemptyset(&sigmask);
+        sigprocmask(SIG_SETMASK, &sigmask, nullptr);
+
+        setpgid(0, 0);
+        execvp(argv[0], argv.data());
+        _exit(127);
+      }
+
+      m_log.trace("runner: Started child process (%d)", job.pid);
+
+      if (job.callback) {
+        close(output[PIPE_WRITE]);
+        fcntl(output[PIPE_READ], F_SETFL, O_NONBLOCK);
+        job.output = output[PIPE_READ];
+      }
+
+#ifdef SYS_pidfd_open
+      job.pidfd = syscall(SYS_pidfd_open, job.pid, 0);
+#endif
+    }
+
+    /**
+     * Forward complete lines of output
+     */
+    void read_output(job& job, bool flush = false) {
+      if (job.output == -1)
+        return;
+
+      char buf[BUFSIZ];
+      ssize_t bytes;
+
+      while ((bytes = ::read(job.output, buf, sizeof(buf))) > 0) job.buffer.append(buf, bytes);
+
+      if (bytes == 0 || flush) {
+        close(job.output);
+        job.output = -1;
+      }
+
+      size_t pos;
+      while ((pos = job.buffer.find('\n')) != string::npos) {
+        job.callback(job.buffer.substr(0, pos));
+        job.buffer.erase(0, pos + 1);
+      }
+
+      if (job.output == -1 && !job.buffer.empty()) {
+        job.callback(job.buffer);
+        job.buffer.clear();
+      }
+    }
+
+    /**
+     * Collect exited children and release their slots
+     */
+    void reap() {
+      for (auto it = m_jobs.begin(); it != m_jobs.end();) {
+        int status{0};
+        auto pid = process_util::wait_for_completion_nohang(it->pid, &status);
+
+        // ECHILD means that someone else reaped the child
+        if (pid == 0 || (pid == -1 && errno != ECHILD)) {
+          ++it;
+          continue;
+        }
+
+        if (pid == -1)
+          m_log.trace("runner: Child process reaped elsewhere (%d)", it->pid);
+        else if (WIFEXITED(status) && WEXITSTATUS(status) != 0)
+          m_log.warn("runner: Command exited with status %d (%s)", WEXITSTATUS(status), it->cmd);
+        else if (WIFSIGNALED(status))
+          m_log.trace("runner: Command killed by signal %d (%s)", WTERMSIG(status), it->cmd);
+        else
+          m_log.trace("runner: Command finished (%s)", it->cmd);
+
+        read_output(*it, true);
+        release(it->cmd);
+        close_job(*it);
+        it = m_jobs.erase(it);
+      }
+    }
+
+    /**
+     * Free the slot held by a command, letting a queued repeat take its place
+     */
+    void release(const string& cmd) {
+      std::lock_guard<std::mutex> guard(m_mtx);
+
+      auto waiting = std::find_if(m_waiting.begin(), m_waiting.end(),
+          [&](const job& pending) { return pending.cmd == cmd; });
+
+      if (waiting != m_waiting.end()) {
+        m_queue.emplace_back(move(*waiting));
+        m_waiting.erase(waiting);
+      } else if (--m_active[cmd] == 0) {
+        m_active.erase(cmd);
+      }
+    }
+
+    void close_job(job& job) {
+      if (job.output != -1)
+        close(job.output);
+      if (job.pidfd != -1)
+        close(job.pidfd);
+      job.output = job.pidfd = -1;
+    }
+
+   private:
+    static constexpr int REAP_INTERVAL_MS{100};
+
+    const logger& m_log;
+    size_t m_limit;
+    repeat_policy m_policy;
+
+    std::mutex m_mtx;
+    map<string, size_t> m_active;
+    std::deque<job> m_queue;
+    std::deque<job> m_waiting;
+
+    std::list<job> m_jobs;
+    int m_wakeup[2]{-1, -1};
+
+    stateflag m_running{true};
+    thread m_thread;
+  };
+
+  using runner_t = unique_ptr<runner>;
+
+  template <typename... Args>
+  runner_t make_runner(Args&&... args) {
+    return make_unique<runner>(configure_logger().create<const logger&>(), forward<Args>(args)...);
+  }
 }
 
 LEMONBUDDY_NS_END
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "common.hpp"
+
+LEMONBUDDY_NS
+
+namespace format_util {
+  using tag_t = size_t;
+
+  /**
+   * Get the id of a format tag, e.g. "<label>"
+   *
+   * Evaluates at compile time for tag constants so that they can
+   * be used as case labels when dispatching on the id
+   *
+   * @return non-zero id, 0 is reserved for literal text
+   */
+  constexpr tag_t tag_id(const char* tag) {
+    tag_t hash{14695981039346656037ULL};
+    while (*tag != '\0') hash = (hash ^ static_cast<unsigned char>(*tag++)) * 1099511628211ULL;
+    return hash != 0 ? hash : 1;
+  }
+
+  inline tag_t tag_id(const string& tag) {
+    return tag_id(tag.c_str());
+  }
+
+  /**
+   * Part of a compiled format, either a tag or literal text
+   */
+  struct chunk {
+    tag_t tag;    // 0 for literal text
+    string text;  // tag name or literal text, empty for a blank between tags
+  };
+
+  /**
+   * Check if the word is a tag
+   */
+  inline bool is_tag(const string& word) {
+    return word.length() > 1 && word.front() == '<' && word.back() == '>';
+  }
+
+  /**
+   * Split the format into tags and literal text once so that the
+   * output can be built without parsing the format on each update
+   */
+  inline vector<chunk> compile(const string& format) {
+    vector<chunk> chunks;
+    size_t start{0};
+
+    // Consecutive spaces produce empty words, a trailing space does not
+    while (start < format.length()) {
+      auto end = format.find(' ', start);
+      if (end == string::npos)
+        end = format.length();
+
+      auto word = format.substr(start, end - start);
+
+      if (is_tag(word))
+        chunks.emplace_back(chunk{tag_id(word), move(word)});
+      else
+        chunks.emplace_back(chunk{0, move(word)});
+
+      start = end + 1;
+    }
+
+    return chunks;
+  }
+}
+
+LEMONBUDDY_NS_END
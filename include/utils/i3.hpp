@@ -22,21 +22,30 @@ namespace i3_util {
    */
   auto root_windows(connection& conn, string output_name = "") {
     vector<xcb_window_t> roots;
-    auto children = conn.query_tree(conn.screen()->root).children();
+    auto tree = conn.query_tree(conn.screen()->root);
+    vector<xcb_window_t> children{tree.children().begin(), tree.children().end()};
 
-    for (auto it = children.begin(); it != children.end(); it++) {
-      auto cookie = xcb_icccm_get_wm_name(conn, *it);
+    // Request the name of all windows before waiting for the first reply
+    vector<xcb_get_property_cookie_t> cookies;
+    for (auto&& child : children) cookies.emplace_back(xcb_icccm_get_wm_name(conn, child));
+
+    for (size_t i = 0; i < children.size(); i++) {
       xcb_icccm_get_text_property_reply_t reply;
 
-      if (xcb_icccm_get_wm_name_reply(conn, cookie, &reply, nullptr) == 0)
+      if (xcb_icccm_get_wm_name_reply(conn, cookies[i], &reply, nullptr) == 0)
         continue;
 
-      if (("[i3 con] output " + output_name).compare(0, 16 + output_name.length(), reply.name) != 0)
+      string name{reply.name, reply.name_len};
+      xcb_icccm_get_text_property_reply_wipe(&reply);
+
+      if (("[i3 con] output " + output_name).compare(0, 16 + output_name.length(), name) != 0)
         continue;
 
-      roots.emplace_back(*it);
+      roots.emplace_back(children[i]);
     }
 
+    conn.count_roundtrip(2);
+
     return roots;
   }
 
@@ -53,6 +62,7 @@ namespace i3_util {
 
       conn.configure_window_checked(win, value_mask, value_list);
       conn.flush();
+      conn.count_roundtrip();
 
       return true;
     }
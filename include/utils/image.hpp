@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+
+#include "common.hpp"
+#include "utils/string.hpp"
+
+#if ENABLE_PNG
+#include <png.h>
+#endif
+
+LEMONBUDDY_NS
+
+namespace image_util {
+  DEFINE_ERROR(image_error);
+
+  /**
+   * Largest accepted image dimension, icons are expected to be small
+   */
+  static constexpr uint16_t MAX_DIMENSION{1024};
+
+  /**
+   * Decoded image with premultiplied ARGB32 pixels
+   */
+  struct image {
+    uint16_t width = 0;
+    uint16_t height = 0;
+    vector<uint32_t> pixels;
+  };
+
+  /**
+   * Pack the channels into a premultiplied ARGB32 pixel
+   */
+  inline uint32_t premultiply(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (a != 0xff) {
+      r = (r * a + 127) / 255;
+      g = (g * a + 127) / 255;
+      b = (b * a + 127) / 255;
+    }
+    return static_cast<uint32_t>(a) << 24 | r << 16 | g << 8 | b;
+  }
+
+  namespace {
+    /**
+     * Parse the color of a xpm color definition,
+     * e.g. "#ffcc00", "#fc0", "#ffffcccc0000" or "None"
+     */
+    inline uint32_t parse_xpm_color(string value) {
+      value = string_util::lower(value);
+
+      if (value == "none")
+        return 0;
+      else if (value == "black")
+        return 0xff000000;
+      else if (value == "white")
+        return 0xffffffff;
+      else if (value.empty() || value[0] != '#')
+        throw image_error("Unsupported xpm color '" + value + "'");
+
+      auto hex = value.substr(1);
+      size_t digits = hex.length() / 3;
+
+      if (hex.length() % 3 != 0 || digits == 0 || digits > 4 ||
+          hex.find_first_not_of("0123456789abcdef") != string::npos)
+        throw image_error("Invalid xpm color '" + value + "'");
+
+      uint32_t pixel = 0xff000000;
+
+      for (size_t i = 0; i < 3; i++) {
+        auto channel = std::stoul(hex.substr(i * digits, digits), nullptr, 16);
+        // Scale the channel to 8 bits, e.g. "f" -> 0xff and "ffff" -> 0xff
+        if (digits == 1)
+          channel *= 0x11;
+        else
+          channel >>= (digits - 2) * 4;
+        pixel |= channel << (16 - i * 8);
+      }
+
+      return pixel;
+    }
+  }
+
+  /**
+   * Parse the contents of a XPM3 image
+   */
+  inline image parse_xpm(const string& contents) {
+    vector<string> strings;
+
+    for (size_t pos = 0; (pos = contents.find('"', pos)) != string::npos;) {
+      auto end = contents.find('"', pos + 1);
+      if (end == string::npos)
+        throw image_error("Unterminated string in xpm data");
+      strings.emplace_back(contents.substr(pos + 1, end - pos - 1));
+      pos = end + 1;
+    }
+
+    if (strings.empty())
+      throw image_error("Missing xpm header");
+
+    int width = 0, height = 0, ncolors = 0, cpp = 0;
+    std::stringstream header(strings[0]);
+    header >> width >> height >> ncolors >> cpp;
+
+    if (header.fail() || width <= 0 || height <= 0 || ncolors <= 0 || cpp <= 0)
+      throw image_error("Invalid xpm header '" + strings[0] + "'");
+    else if (width > MAX_DIMENSION || height > MAX_DIMENSION)
+      throw image_error("Image dimensions exceed " + to_string(MAX_DIMENSION) + "px");
+    else if (strings.size() < static_cast<size_t>(1 + ncolors + height))
+      throw image_error("Truncated xpm data");
+
+    map<string, uint32_t> colors;
+
+    for (int i = 1; i <= ncolors; i++) {
+      const auto& line = strings[i];
+
+      if (line.length() < static_cast<size_t>(cpp))
+        throw image_error("Invalid xpm color definition '" + line + "'");
+
+      // Only the color visual ("c") is used, any other keys are ignored
+      std::stringstream tokens(line.substr(cpp));
+      string token, value;
+
+      while (tokens >> token) {
+        if (token == "c" && tokens >> value)
+          break;
+        value.clear();
+      }
+
+      if (value.empty())
+        throw image_error("Missing color visual in '" + line + "'");
+
+      colors.emplace(line.substr(0, cpp), parse_xpm_color(value));
+    }
+
+    image img;
+    img.width = width;
+    img.height = height;
+    img.pixels.reserve(width * height);
+
+    for (int y = 0; y < height; y++) {
+      const auto& row = strings[1 + ncolors + y];
+
+      if (row.length() < static_cast<size_t>(width * cpp))
+        throw image_error("Truncated xpm row " + to_string(y));
+
+      for (int x = 0; x < width; x++) {
+        auto color = colors.find(row.substr(x * cpp, cpp));
+        if (color == colors.end())
+          throw image_error("Undefined xpm color at " + to_string(x) + "," + to_string(y));
+        img.pixels.emplace_back(color->second);
+      }
+    }
+
+    return img;
+  }
+
+  /**
+   * Load a XPM image from disk
+   */
+  inline image load_xpm(const string& path) {
+    std::ifstream in(path);
+
+    if (!in)
+      throw image_error("Failed to open '" + path + "'");
+
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+
+    return parse_xpm(buffer.str());
+  }
+
+#if ENABLE_PNG
+  /**
+   * Load a PNG image from disk using the simplified libpng api
+   */
+  inline image load_png(const string& path) {
+    png_image png;
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+
+    if (!png_image_begin_read_from_file(&png, path.c_str()))
+      throw image_error("Failed to read '" + path + "' (" + string{png.message} + ")");
+
+    if (png.width > MAX_DIMENSION || png.height > MAX_DIMENSION) {
+      png_image_free(&png);
+      throw image_error("Image dimensions exceed " + to_string(MAX_DIMENSION) + "px");
+    }
+
+    png.format = PNG_FORMAT_RGBA;
+    vector<uint8_t> buffer(PNG_IMAGE_SIZE(png));
+
+    if (!png_image_finish_read(&png, nullptr, buffer.data(), 0, nullptr))
+      throw image_error("Failed to decode '" + path + "' (" + string{png.message} + ")");
+
+    image img;
+    img.width = png.width;
+    img.height = png.height;
+    img.pixels.reserve(png.width * png.height);
+
+    for (size_t i = 0; i + 3 < buffer.size(); i += 4)
+      img.pixels.emplace_back(premultiply(buffer[i], buffer[i + 1], buffer[i + 2], buffer[i + 3]));
+
+    return img;
+  }
+#endif
+
+  /**
+   * Load an image from disk, the format is determined by the file extension
+   */
+  inline image load(const string& path) {
+    auto dot = path.rfind('.');
+    auto ext = string_util::lower(dot != string::npos ? path.substr(dot + 1) : "");
+
+    if (ext == "xpm")
+      return load_xpm(path);
+#if ENABLE_PNG
+    else if (ext == "png")
+      return load_png(path);
+#endif
+
+    throw image_error("Unsupported image format '" + path + "'");
+  }
+}
+
+LEMONBUDDY_NS_END
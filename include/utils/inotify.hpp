@@ -1,8 +1,12 @@
 #pragma once
 
+#include <sys/eventfd.h>
 #include <sys/inotify.h>
 #include <sys/poll.h>
+#include <unistd.h>
+#include <algorithm>
 #include <cstdio>
+#include <mutex>
 
 #include "common.hpp"
 #include "utils/memory.hpp"
@@ -19,86 +23,281 @@ struct inotify_event {
   int mask = 0;
 };
 
-class inotify_watch {
+using inotify_callback = function<void(const inotify_event&)>;
+
+/**
+ * Process-wide inotify instance
+ *
+ * All watches share a single inotify fd that is read by one thread,
+ * which dispatches each event to the callbacks registered for its
+ * watch descriptor. Watches stay attached until they are removed, so
+ * the latency doesn't depend on the number of watched paths.
+ *
+ * Callbacks are called from the service thread with the service
+ * locked, so they should return quickly and must not add or remove
+ * watches themselves.
+ */
+class inotify_service {
  public:
-  /**
-   * Constructor
-   */
-  explicit inotify_watch(string path) : m_path(path) {}
+  static inotify_service& instance() {
+    static inotify_service service;
+    return service;
+  }
+
+  ~inotify_service() {
+    if (m_thread.joinable()) {
+      m_running = false;
+      eventfd_write(m_wakeup, 1);
+      m_thread.join();
+    }
 
-  /**
-   * Destructor
-   */
-  ~inotify_watch() noexcept {
-    if (m_wd != -1)
-      inotify_rm_watch(m_fd, m_wd);
     if (m_fd != -1)
       close(m_fd);
+    if (m_wakeup != -1)
+      close(m_wakeup);
   }
 
   /**
-   * Attach inotify watch
+   * Watch the path and call fn for each event matching the mask
+   *
+   * Watches that are removed by the kernel, e.g. because an editor
+   * replaced the file, are attached again once the path exists
+   *
+   * @return id used to remove the watch
    */
-  void attach(int mask = IN_MODIFY) {
-    if (m_fd == -1 && (m_fd = inotify_init()) == -1)
+  size_t add(const string& path, int mask, inotify_callback&& fn) {  // {{{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    if (m_fd == -1 && (m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1)
       throw system_error("Failed to allocate inotify fd");
-    if ((m_wd = inotify_add_watch(m_fd, m_path.c_str(), mask)) == -1)
+    if (m_wakeup == -1 && (m_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+      throw system_error("Failed to create inotify wakeup fd");
+
+    subscription sub{path, mask, -1, forward<decltype(fn)>(fn)};
+
+    if (!attach(sub))
       throw system_error("Failed to attach inotify watch");
-  }
+
+    auto id = ++m_nextid;
+    m_watches[sub.wd].emplace_back(id);
+    m_subscriptions.emplace(id, move(sub));
+
+    if (!m_thread.joinable()) {
+      m_running = true;
+      m_thread = thread(&inotify_service::runner, this);
+    }
+
+    return id;
+  }  // }}}
 
   /**
-   * Remove inotify watch
+   * Remove the watch, its callback won't be called after this returns
    */
-  void remove() {
-    if (inotify_rm_watch(m_fd, m_wd) == -1)
-      throw system_error("Failed to remove inotify watch");
-    m_wd = -1;
-  }
+  void remove(size_t id) {  // {{{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto sub = m_subscriptions.find(id);
+    if (sub == m_subscriptions.end())
+      return;
+
+    detach(id, sub->second.wd, true);
+    m_subscriptions.erase(sub);
+  }  // }}}
 
   /**
-   * Poll the inotify fd for events
-   *
-   * @brief A wait_ms of -1 blocks until an event is fired
+   * Dispatch the events that are already queued without waiting
+   * for the service thread
    */
-  bool poll(int wait_ms = 1000) {
-    if (m_fd == -1)
-      return false;
+  void sync() {  // {{{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    read_events();
+  }  // }}}
 
-    struct pollfd fds[1];
-    fds[0].fd = m_fd;
-    fds[0].events = POLLIN;
+ protected:
+  struct subscription {
+    string path;
+    int mask;
+    int wd;
+    inotify_callback callback;
+  };
 
-    ::poll(fds, 1, wait_ms);
+  inotify_service() = default;
 
-    return fds[0].revents & POLLIN;
-  }
+  void runner() {  // {{{
+    while (m_running) {
+      pollfd fds[2]{{m_fd, POLLIN, 0}, {m_wakeup, POLLIN, 0}};
+      int timeout{-1};
+
+      // Retry watches whose path was removed every second
+      {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_detached > 0)
+          timeout = 1000;
+      }
+
+      ::poll(fds, 2, timeout);
+
+      if (!m_running)
+        break;
+
+      if (fds[1].revents & POLLIN) {
+        eventfd_t value;
+        eventfd_read(m_wakeup, &value);
+      }
+
+      std::lock_guard<std::mutex> guard(m_mutex);
+      read_events();
+      reattach();
+    }
+  }  // }}}
+
+  void read_events() {  // {{{
+    alignas(inotify_event_t) char buffer[4096];
+    ssize_t bytes;
+
+    while ((bytes = read(m_fd, buffer, sizeof(buffer))) > 0) {
+      for (ssize_t len = 0; len < bytes;) {
+        auto* e = reinterpret_cast<inotify_event_t*>(&buffer[len]);
+        len += sizeof(inotify_event_t) + e->len;
+
+        if (e->mask & IN_Q_OVERFLOW)
+          resync();
+        else
+          dispatch(e);
+      }
+    }
+  }  // }}}
+
+  void dispatch(const inotify_event_t* e) {  // {{{
+    auto watch = m_watches.find(e->wd);
+    if (watch == m_watches.end())
+      return;
+
+    // Copy the ids since the watch is dropped below if it was removed
+    auto ids = watch->second;
+
+    if (e->mask & IN_IGNORED) {
+      for (auto&& id : ids) detach(id, e->wd, false);
+    }
+
+    for (auto&& id : ids) {
+      auto& sub = m_subscriptions.at(id);
+
+      if (!(e->mask & (sub.mask | IN_IGNORED | IN_UNMOUNT)))
+        continue;
+
+      inotify_event event;
+      event.filename = e->len ? e->name : sub.path;
+      event.is_dir = e->mask & IN_ISDIR;
+      event.wd = e->wd;
+      event.cookie = e->cookie;
+      event.mask = e->mask;
+      sub.callback(event);
+    }
+  }  // }}}
 
   /**
-   * Get the latest inotify event
+   * Notify all watches after events were dropped because the queue
+   * overflowed, so that they can read the current state again
    */
-  unique_ptr<inotify_event> get_event() {
-    auto event = make_unique<inotify_event>();
+  void resync() {  // {{{
+    for (auto&& sub : m_subscriptions) {
+      inotify_event event;
+      event.filename = sub.second.path;
+      event.is_dir = false;
+      event.wd = sub.second.wd;
+      event.mask = IN_Q_OVERFLOW;
+      sub.second.callback(event);
+    }
+  }  // }}}
+
+  bool attach(subscription& sub) {  // {{{
+    // Several subscriptions for the same file share the watch descriptor
+    sub.wd = inotify_add_watch(m_fd, sub.path.c_str(), sub.mask | IN_MASK_ADD);
+    return sub.wd != -1;
+  }  // }}}
 
-    if (m_fd == -1 || m_wd == -1)
-      return event;
+  void detach(size_t id, int wd, bool remove_watch) {  // {{{
+    if (wd == -1) {
+      m_detached--;
+      return;
+    }
 
-    char buffer[1024];
-    size_t bytes = read(m_fd, buffer, 1024);
-    size_t len = 0;
+    auto watch = m_watches.find(wd);
+    if (watch != m_watches.end()) {
+      auto& ids = watch->second;
+      ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+
+      if (ids.empty()) {
+        if (remove_watch)
+          inotify_rm_watch(m_fd, wd);
+        m_watches.erase(watch);
+      }
+    }
 
-    while (len < bytes) {
-      auto* e = reinterpret_cast<inotify_event_t*>(&buffer[len]);
+    if (!remove_watch) {
+      m_subscriptions.at(id).wd = -1;
+      m_detached++;
+    }
+  }  // }}}
 
-      event->filename = e->len ? e->name : m_path;
-      event->wd = e->wd;
-      event->cookie = e->cookie;
-      event->is_dir = e->mask & IN_ISDIR;
-      event->mask |= e->mask;
+  void reattach() {  // {{{
+    if (m_detached == 0)
+      return;
 
-      len += sizeof(inotify_event_t) + e->len;
+    for (auto&& sub : m_subscriptions) {
+      if (sub.second.wd == -1 && attach(sub.second)) {
+        m_watches[sub.second.wd].emplace_back(sub.first);
+        m_detached--;
+      }
     }
+  }  // }}}
+
+ private:
+  std::mutex m_mutex;
+  int m_fd{-1};
+  int m_wakeup{-1};
+  stateflag m_running{false};
+  thread m_thread;
+
+  size_t m_nextid{0};
+  size_t m_detached{0};
+  map<size_t, subscription> m_subscriptions;
+  map<int, vector<size_t>> m_watches;
+};
+
+/**
+ * Watch on a single path, removed when destroyed
+ */
+class inotify_watch {
+ public:
+  /**
+   * Constructor
+   */
+  explicit inotify_watch(string path) : m_path(path) {}
 
-    return event;
+  /**
+   * Destructor
+   */
+  ~inotify_watch() noexcept {
+    remove();
+  }
+
+  /**
+   * Attach inotify watch
+   */
+  void attach(int mask, inotify_callback&& fn) {
+    remove();
+    m_id = inotify_service::instance().add(m_path, mask, forward<decltype(fn)>(fn));
+  }
+
+  /**
+   * Remove inotify watch
+   */
+  void remove() {
+    if (m_id != 0)
+      inotify_service::instance().remove(m_id);
+    m_id = 0;
   }
 
   /**
@@ -110,13 +309,25 @@ class inotify_watch {
 
  protected:
   string m_path;
-  int m_fd = -1;
-  int m_wd = -1;
+  size_t m_id = 0;
 };
 
 using inotify_watch_t = unique_ptr<inotify_watch>;
 
 namespace inotify_util {
+  /**
+   * Events caused by only reading a watched file
+   */
+  constexpr int READ_EVENTS{IN_ACCESS | IN_OPEN | IN_CLOSE_NOWRITE};
+
+  /**
+   * Remove the events that reading a watched file causes, e.g. to
+   * tell changes apart from the reads done while handling an event
+   */
+  inline int strip_reads(int mask) {
+    return mask & ~READ_EVENTS;
+  }
+
   inline auto make_watch(string path) {
     di::injector<inotify_watch_t> injector = di::make_injector(di::bind<>().to(path));
     return injector.create<inotify_watch_t>();
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+
+#include "common.hpp"
+#include "utils/file.hpp"
+#include "utils/string.hpp"
+
+LEMONBUDDY_NS
+
+namespace snapshot_util {
+  static constexpr const char* SIGNATURE{"lemonbuddy-snapshot"};
+  static constexpr int VERSION{1};
+
+  /**
+   * Get the path of the snapshot file for the given bar
+   *
+   * @return empty string if XDG_RUNTIME_DIR is not set
+   */
+  inline string path(const string& bar_name) {
+    auto runtime_dir = read_env("XDG_RUNTIME_DIR");
+    if (runtime_dir.empty())
+      return "";
+    return runtime_dir + "/lemonbuddy-" + bar_name + ".snapshot";
+  }
+
+  /**
+   * Escape line breaks, tabs and backslashes
+   */
+  inline string escape(const string& value) {
+    string escaped;
+    escaped.reserve(value.size());
+
+    for (auto&& c : value) {
+      if (c == '\\')
+        escaped += "\\\\";
+      else if (c == '\n')
+        escaped += "\\n";
+      else if (c == '\t')
+        escaped += "\\t";
+      else
+        escaped += c;
+    }
+
+    return escaped;
+  }
+
+  /**
+   * Reverse escape()
+   */
+  inline string unescape(const string& value) {
+    string unescaped;
+    unescaped.reserve(value.size());
+
+    for (size_t i = 0; i < value.size(); i++) {
+      if (value[i] != '\\' || i + 1 == value.size()) {
+        unescaped += value[i];
+      } else if (value[++i] == 'n') {
+        unescaped += '\n';
+      } else if (value[i] == 't') {
+        unescaped += '\t';
+      } else {
+        unescaped += value[i];
+      }
+    }
+
+    return unescaped;
+  }
+
+  /**
+   * Serialize the output of the modules
+   *
+   * @param key Identifies the configuration the output belongs to
+   */
+  inline string serialize(const string& key, const map<string, string>& outputs) {
+    string data{string{SIGNATURE} + " " + to_string(VERSION) + "\n" + escape(key) + "\n"};
+
+    for (auto&& output : outputs) {
+      data += escape(output.first) + "\t" + escape(output.second) + "\n";
+    }
+
+    return data;
+  }
+
+  /**
+   * Deserialize the output of the modules
+   *
+   * @return empty map if the data has another version or key
+   */
+  inline map<string, string> deserialize(const string& key, const string& data) {
+    map<string, string> outputs;
+    auto lines = string_util::split(data, '\n');
+
+    if (lines.size() < 2)
+      return outputs;
+    if (lines[0] != string{SIGNATURE} + " " + to_string(VERSION))
+      return outputs;
+    if (unescape(lines[1]) != key)
+      return outputs;
+
+    for (size_t i = 2; i < lines.size(); i++) {
+      auto separator = lines[i].find('\t');
+      if (separator == string::npos)
+        continue;
+      outputs.emplace(
+          unescape(lines[i].substr(0, separator)), unescape(lines[i].substr(separator + 1)));
+    }
+
+    return outputs;
+  }
+
+  /**
+   * Load the snapshot stored at given path
+   */
+  inline map<string, string> load(const string& path, const string& key) {
+    if (path.empty() || !file_util::exists(path))
+      return {};
+    return deserialize(key, file_util::get_contents(path));
+  }
+
+  /**
+   * Store a snapshot at given path
+   *
+   * The data is written to a temporary file that then replaces
+   * the snapshot, so readers never see a partial snapshot
+   */
+  inline bool save(const string& path, const string& data) {
+    if (path.empty())
+      return false;
+
+    auto tmp = path + ".tmp";
+
+    {
+      std::ofstream ofs(tmp, std::ios::trunc);
+      ofs << data;
+      if (!ofs.flush())
+        return false;
+    }
+
+    return rename(tmp.c_str(), path.c_str()) == 0;
+  }
+}
+
+LEMONBUDDY_NS_END
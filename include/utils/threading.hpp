@@ -1,5 +1,13 @@
 #pragma once
 
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
 
 #include "common.hpp"
@@ -57,6 +65,290 @@ namespace threading_util {
    protected:
     std::atomic_flag m_locked{false};
   };
+
+  /**
+   * Hint the cpu that the caller is busy-waiting
+   */
+  inline void cpu_relax() {
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#endif
+  }
+
+  /**
+   * Contention counters of an adaptive_lock
+   */
+  struct lock_metrics {
+    std::atomic<uint64_t> acquisitions{0};
+    std::atomic<uint64_t> contended{0};
+    std::atomic<uint64_t> spins{0};
+    std::atomic<uint64_t> parks{0};
+    std::atomic<uint64_t> parked_ns{0};
+  };
+
+  /**
+   * Lock that spins briefly and then parks the thread on a futex
+   *
+   * Short critical sections are taken over without a context switch,
+   * while threads waiting on a long one, e.g. a module blocking on
+   * i/o while holding its update lock, sleep instead of burning cpu.
+   *
+   * The state is 0 when unlocked, 1 when locked and 2 when locked
+   * with threads possibly parked on it.
+   */
+  class adaptive_lock : public non_copyable_mixin<adaptive_lock> {
+   public:
+    static constexpr int SPIN_LIMIT{100};
+
+    /**
+     * Construct adaptive_lock
+     */
+    adaptive_lock() = default;
+
+    /**
+     * Lock, spinning briefly before parking the thread
+     */
+    void lock() noexcept {
+      int state{0};
+
+      if (m_state.compare_exchange_strong(state, 1, std::memory_order_acquire)) {
+        if (m_metrics != nullptr)
+          m_metrics->acquisitions.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+
+      lock_contended();
+    }
+
+    /**
+     * Lock if it is available without waiting
+     */
+    bool try_lock() noexcept {
+      int state{0};
+
+      if (!m_state.compare_exchange_strong(state, 1, std::memory_order_acquire))
+        return false;
+      if (m_metrics != nullptr)
+        m_metrics->acquisitions.fetch_add(1, std::memory_order_relaxed);
+
+      return true;
+    }
+
+    /**
+     * Unlock, waking up one parked thread if there are any
+     */
+    void unlock() noexcept {
+      if (m_state.exchange(0, std::memory_order_release) == 2)
+        futex(FUTEX_WAKE_PRIVATE, 1);
+    }
+
+    /**
+     * Collect contention counters into the given metrics,
+     * pass nullptr to stop collecting
+     */
+    void set_metrics(lock_metrics* metrics) noexcept {
+      m_metrics = metrics;
+    }
+
+   protected:
+    void lock_contended() noexcept {
+      int state{0};
+      int spins{0};
+
+      for (; spins < SPIN_LIMIT; spins++) {
+        state = m_state.load(std::memory_order_relaxed);
+        if (state == 0 && m_state.compare_exchange_weak(state, 1, std::memory_order_acquire))
+          break;
+        if (state == 2)
+          break;
+        cpu_relax();
+      }
+
+      uint64_t parks{0};
+      chrono::steady_clock::time_point parked;
+
+      if (state != 0 || spins == SPIN_LIMIT) {
+        if (m_metrics != nullptr)
+          parked = chrono::steady_clock::now();
+
+        // Mark the lock as having waiters before going to sleep
+        while (m_state.exchange(2, std::memory_order_acquire) != 0) {
+          futex(FUTEX_WAIT_PRIVATE, 2);
+          parks++;
+        }
+      }
+
+      if (m_metrics != nullptr) {
+        m_metrics->acquisitions.fetch_add(1, std::memory_order_relaxed);
+        m_metrics->contended.fetch_add(1, std::memory_order_relaxed);
+        m_metrics->spins.fetch_add(spins, std::memory_order_relaxed);
+
+        if (parks > 0) {
+          m_metrics->parks.fetch_add(parks, std::memory_order_relaxed);
+          m_metrics->parked_ns.fetch_add(
+              chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - parked)
+                  .count(),
+              std::memory_order_relaxed);
+        }
+      }
+    }
+
+    void futex(int op, int value) noexcept {
+      static_assert(sizeof(m_state) == sizeof(int), "futex word must be an int");
+      syscall(SYS_futex, reinterpret_cast<int*>(&m_state), op, value, nullptr, nullptr, 0);
+    }
+
+   private:
+    std::atomic<int> m_state{0};
+    lock_metrics* m_metrics{nullptr};
+  };
+
+  /**
+   * Value that is replaced as a whole by writers and read without waiting on them
+   *
+   * Every store publishes a new immutable buffer. Readers share the buffer
+   * instead of copying it, and a buffer stays alive until its last reader
+   * releases it.
+   *
+   * The buffers are kept in a few slots. A reader announces itself on the
+   * current slot before taking a reference and retries if a store moved on
+   * in the meantime. Writers only reuse a slot that is neither current nor
+   * announced, so reads never take a lock. Concurrent stores are serialized
+   * among themselves.
+   */
+  template <typename T>
+  class publisher : public non_copyable_mixin<publisher<T>> {
+   public:
+    using value_t = shared_ptr<const T>;
+
+    /**
+     * Construct publisher
+     */
+    explicit publisher(T value = T{}) {
+      m_slots[0] = make_shared<const T>(move(value));
+    }
+
+    /**
+     * Get the most recently published value
+     */
+    value_t load() const {
+      while (true) {
+        auto index = m_current.load();
+        m_readers[index].fetch_add(1);
+
+        // The slot can't be reused while it's announced and still current
+        if (m_current.load() == index) {
+          value_t value{m_slots[index]};
+          m_readers[index].fetch_sub(1);
+          return value;
+        }
+
+        m_readers[index].fetch_sub(1);
+      }
+    }
+
+    /**
+     * Publish a new value
+     */
+    void store(T value) {
+      value_t next{make_shared<const T>(move(value))};
+      std::lock_guard<std::mutex> lck(m_writelock);
+
+      auto current = m_current.load();
+      auto index = current;
+
+      // Readers only hold a slot while taking a reference, so a free one is found quickly
+      do {
+        if ((index = (index + 1) % SLOTS) == current)
+          this_thread::yield();
+      } while (index == current || m_readers[index].load() != 0);
+
+      m_slots[index] = move(next);
+      m_current.store(index);
+    }
+
+   private:
+    static constexpr size_t SLOTS{3};
+
+    std::mutex m_writelock;
+    std::atomic<size_t> m_current{0};
+    mutable array<std::atomic<size_t>, SLOTS> m_readers{};
+    array<value_t, SLOTS> m_slots;
+  };
+
+  /**
+   * Single slot handing the latest value from producers to one consumer
+   *
+   * Putting a value replaces the one that is still waiting in the slot,
+   * so the consumer never works through stale values.
+   */
+  template <typename T>
+  class mailbox : public non_copyable_mixin<mailbox<T>> {
+   public:
+    /**
+     * Put a value into the slot
+     *
+     * @return false if a value that wasn't taken yet got replaced
+     */
+    bool put(T value) {
+      bool replaced;
+      {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        replaced = m_full;
+        m_value = move(value);
+        m_full = true;
+      }
+      m_cond.notify_one();
+      return !replaced;
+    }
+
+    /**
+     * Wait for a value and take it out of the slot
+     *
+     * @return false once the mailbox is closed
+     */
+    bool take(T& value) {
+      std::unique_lock<std::mutex> lck(m_mutex);
+      m_cond.wait(lck, [this] { return m_full || m_closed; });
+
+      if (m_closed)
+        return false;
+
+      value = move(m_value);
+      m_value = T{};
+      m_full = false;
+      return true;
+    }
+
+    /**
+     * Drop the value waiting in the slot
+     */
+    void clear() {
+      std::lock_guard<std::mutex> lck(m_mutex);
+      m_value = T{};
+      m_full = false;
+    }
+
+    /**
+     * Wake up the consumer, values put afterwards are never taken
+     */
+    void close() {
+      {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        m_closed = true;
+      }
+      m_cond.notify_all();
+    }
+
+   private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    T m_value{};
+    bool m_full{false};
+    bool m_closed{false};
+  };
 }
 
 LEMONBUDDY_NS_END
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <deque>
+#include <limits>
+#include <mutex>
 
 #include "common.hpp"
 #include "components/logger.hpp"
@@ -101,6 +107,223 @@ namespace throttle_util {
     timewindow m_timewindow;
   };
 
+  /**
+   * Monotonic timestamp in nanoseconds, used by the lock-free throttlers
+   */
+  inline int64_t steady_now() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  /**
+   * Allow events at a steady rate with room for short bursts
+   *
+   * The bucket holds up to <burst> tokens and is refilled with
+   * <rate> tokens per second. Each passing event takes one token.
+   *
+   * Instead of counting tokens the bucket tracks the theoretical
+   * arrival time of the next event (GCRA), which fits into a single
+   * atomic and makes each check a lock-free compare-and-swap.
+   */
+  class token_bucket {
+   public:
+    /**
+     * Construct bucket, starting out full
+     */
+    explicit token_bucket(double rate, double burst)
+        : m_interval(static_cast<int64_t>(1e9 / rate))
+        , m_tolerance(static_cast<int64_t>(m_interval * (std::max(1.0, burst) - 1.0))) {}
+
+    /**
+     * Take a token if one is available
+     */
+    bool take() {
+      auto now = steady_now();
+      auto tat = m_tat.load(std::memory_order_relaxed);
+      int64_t next;
+
+      do {
+        auto start = std::max(tat, now);
+        if (start - now > m_tolerance)
+          return false;
+        next = start + m_interval;
+      } while (!m_tat.compare_exchange_weak(tat, next, std::memory_order_relaxed));
+
+      return true;
+    }
+
+   private:
+    const int64_t m_interval;
+    const int64_t m_tolerance;
+    std::atomic<int64_t> m_tat{0};
+  };
+
+  /**
+   * Allow at most <limit> events within a sliding window of time
+   *
+   * Same semantics as the event_throttler, but the timestamps of the
+   * last <limit> events are kept in a fixed ring instead of a deque.
+   * An event passes if the slot it would overwrite, i.e. the oldest
+   * of the last <limit> events, has left the window.
+   *
+   * Each slot carries a sequence number that tells whether the
+   * timestamp of the event that last claimed it has been written.
+   */
+  template <size_t Capacity>
+  class ring_window {
+   public:
+    /**
+     * Construct window, the limit is capped at the ring capacity
+     */
+    explicit ring_window(size_t limit, timewindow window)
+        : m_limit(std::max<size_t>(1, std::min(limit, Capacity)))
+        , m_window(chrono::duration_cast<chrono::nanoseconds>(window).count()) {
+      for (size_t i = 0; i < Capacity; i++) {
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        m_slots[i].timestamp.store(std::numeric_limits<int64_t>::min() / 2,
+            std::memory_order_relaxed);
+      }
+    }
+
+    /**
+     * Check if event is allowed to pass
+     */
+    bool passthrough() {
+      auto now = steady_now();
+
+      while (true) {
+        auto head = m_head.load(std::memory_order_acquire);
+        auto& slot = m_slots[head % m_limit];
+
+        // The previous claim of this slot is still being written
+        if (slot.sequence.load(std::memory_order_acquire) != head) {
+          this_thread::yield();
+          continue;
+        }
+
+        auto timestamp = slot.timestamp.load(std::memory_order_acquire);
+
+        if (m_head.load(std::memory_order_acquire) != head)
+          continue;
+        else if (now - timestamp < m_window)
+          return false;
+        else if (!m_head.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel))
+          continue;
+
+        slot.timestamp.store(now, std::memory_order_release);
+        slot.sequence.store(head + m_limit, std::memory_order_release);
+
+        return true;
+      }
+    }
+
+   private:
+    struct slot {
+      std::atomic<size_t> sequence;
+      std::atomic<int64_t> timestamp;
+    };
+
+    const size_t m_limit;
+    const int64_t m_window;
+    std::atomic<size_t> m_head{0};
+    std::array<slot, Capacity> m_slots;
+  };
+
+  /**
+   * Deliver the last of a series of events once they have
+   * been quiet for a set amount of time (trailing edge)
+   *
+   * Triggering only stores a timestamp, the callback runs on the
+   * debouncer's own thread. The callback is guaranteed to run after
+   * the last trigger, but never more than once per quiet period.
+   *
+   * Example usage:
+   * @code cpp
+   *   throttle_util::debouncer d(100ms, [] { redraw(); });
+   *   d.trigger();
+   * @endcode
+   */
+  class debouncer {
+   public:
+    /**
+     * Construct debouncer and start its thread
+     */
+    explicit debouncer(timewindow quiet, function<void()> callback)
+        : m_quiet(chrono::duration_cast<chrono::nanoseconds>(quiet).count())
+        , m_callback(move(callback))
+        , m_thread(&debouncer::run, this) {}
+
+    /**
+     * Deliver a pending event and stop the thread
+     */
+    ~debouncer() {
+      {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        m_running = false;
+      }
+      m_cond.notify_one();
+      m_thread.join();
+    }
+
+    /**
+     * Register an event
+     */
+    void trigger() {
+      m_last.store(steady_now(), std::memory_order_release);
+
+      // Only the first event of a series needs to wake the thread
+      if (!m_armed.exchange(true, std::memory_order_acq_rel)) {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        m_cond.notify_one();
+      }
+    }
+
+   protected:
+    void run() {
+      std::unique_lock<std::mutex> lck(m_mutex);
+
+      while (true) {
+        m_cond.wait(lck, [this] { return m_armed.load() || !m_running; });
+
+        if (!m_armed)
+          return;
+
+        auto deadline = m_last.load(std::memory_order_acquire) + m_quiet;
+        auto now = steady_now();
+
+        if (now < deadline && m_running) {
+          m_cond.wait_for(lck, chrono::nanoseconds(deadline - now));
+          continue;
+        }
+
+        m_armed.store(false, std::memory_order_release);
+
+        // Events that arrived while disarming start a new series
+        if (m_last.load(std::memory_order_acquire) + m_quiet > steady_now() && m_running) {
+          m_armed.store(true, std::memory_order_release);
+          continue;
+        }
+
+        lck.unlock();
+        m_callback();
+        lck.lock();
+      }
+    }
+
+   private:
+    const int64_t m_quiet;
+    function<void()> m_callback;
+
+    std::atomic<int64_t> m_last{0};
+    std::atomic<bool> m_armed{false};
+    bool m_running{true};
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    thread m_thread;
+  };
+
   using throttle_t = unique_ptr<event_throttler>;
 
   template <typename... Args>
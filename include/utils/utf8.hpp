@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "common.hpp"
+
+LEMONBUDDY_NS
+
+namespace utf8_util {
+  /**
+   * Code point emitted in place of malformed input
+   */
+  static constexpr uint32_t REPLACEMENT_CHAR{0xfffd};
+
+  /**
+   * Get the length of the leading run of ascii bytes
+   *
+   * Scans 32 and 16 bytes at a time using SSE2 or NEON
+   * when available, otherwise 8 bytes at a time
+   */
+  inline size_t ascii_run(const uint8_t* data, size_t len) {
+    size_t n = 0;
+
+#if defined(__SSE2__)
+    for (; n + 32 <= len; n += 32) {
+      auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + n));
+      auto hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + n + 16));
+      if (_mm_movemask_epi8(_mm_or_si128(lo, hi)) != 0)
+        break;
+    }
+    for (; n + 16 <= len; n += 16) {
+      auto mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + n)));
+      if (mask != 0)
+        return n + __builtin_ctz(mask);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; n + 32 <= len; n += 32) {
+      if (vmaxvq_u8(vorrq_u8(vld1q_u8(data + n), vld1q_u8(data + n + 16))) >= 0x80)
+        break;
+    }
+    for (; n + 16 <= len; n += 16) {
+      if (vmaxvq_u8(vld1q_u8(data + n)) >= 0x80)
+        break;
+    }
+#else
+    for (; n + 8 <= len; n += 8) {
+      uint64_t chunk;
+      std::memcpy(&chunk, data + n, sizeof(chunk));
+      if ((chunk & 0x8080808080808080ULL) != 0)
+        break;
+    }
+#endif
+
+    while (n < len && data[n] < 0x80) n++;
+
+    return n;
+  }
+
+  /**
+   * Decode a single utf-8 sequence into its code point
+   *
+   * Malformed input yields REPLACEMENT_CHAR and consumes the maximal
+   * invalid subpart (at least one byte), which means that a truncated
+   * sequence never swallows the bytes following it
+   *
+   * @return Number of bytes consumed
+   */
+  inline size_t decode(const uint8_t* data, size_t len, uint32_t& codepoint) {
+    codepoint = REPLACEMENT_CHAR;
+
+    if (len == 0)
+      return 0;
+
+    uint8_t lead = data[0];
+
+    if (lead < 0x80) {
+      codepoint = lead;
+      return 1;
+    }
+
+    size_t seqlen;
+    uint8_t min = 0x80;
+    uint8_t max = 0xbf;
+
+    // Valid ranges as defined in table 3-7 of the Unicode standard
+    if (lead >= 0xc2 && lead <= 0xdf) {
+      seqlen = 2;
+      codepoint = lead & 0x1f;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+      seqlen = 3;
+      codepoint = lead & 0x0f;
+      if (lead == 0xe0)
+        min = 0xa0;  // overlong
+      else if (lead == 0xed)
+        max = 0x9f;  // surrogates
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+      seqlen = 4;
+      codepoint = lead & 0x07;
+      if (lead == 0xf0)
+        min = 0x90;  // overlong
+      else if (lead == 0xf4)
+        max = 0x8f;  // above U+10FFFF
+    } else {
+      codepoint = REPLACEMENT_CHAR;
+      return 1;
+    }
+
+    for (size_t i = 1; i < seqlen; i++) {
+      if (i >= len || data[i] < min || data[i] > max) {
+        codepoint = REPLACEMENT_CHAR;
+        return i;
+      }
+      codepoint = (codepoint << 6) | (data[i] & 0x3f);
+      min = 0x80;
+      max = 0xbf;
+    }
+
+    return seqlen;
+  }
+
+  /**
+   * Decode a utf-8 encoded string into a list of code points
+   */
+  inline vector<uint32_t> decode(const string& str) {
+    vector<uint32_t> codepoints;
+    auto data = reinterpret_cast<const uint8_t*>(str.data());
+    size_t len = str.length();
+    size_t pos = 0;
+
+    codepoints.reserve(len);
+
+    while (pos < len) {
+      size_t n = ascii_run(data + pos, len - pos);
+      for (size_t i = 0; i < n; i++) codepoints.emplace_back(data[pos + i]);
+      if ((pos += n) == len)
+        break;
+      uint32_t codepoint;
+      pos += decode(data + pos, len - pos, codepoint);
+      codepoints.emplace_back(codepoint);
+    }
+
+    return codepoints;
+  }
+
+  /**
+   * Check if the string is well-formed utf-8
+   */
+  inline bool validate(const string& str) {
+    auto data = reinterpret_cast<const uint8_t*>(str.data());
+    size_t len = str.length();
+    size_t pos = 0;
+
+    while ((pos += ascii_run(data + pos, len - pos)) < len) {
+      uint32_t codepoint;
+      size_t n = decode(data + pos, len - pos, codepoint);
+      // An encoded U+FFFD (ef bf bd) is the only valid sequence decoding to it
+      if (codepoint == REPLACEMENT_CHAR && (n != 3 || data[pos] != 0xef))
+        return false;
+      pos += n;
+    }
+
+    return true;
+  }
+}
+
+LEMONBUDDY_NS_END
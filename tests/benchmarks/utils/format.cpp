@@ -0,0 +1,85 @@
+#include "utils/format.hpp"
+#include "utils/string.hpp"
+
+using namespace lemonbuddy;
+
+static constexpr auto TAG_ANIMATION_CHARGING = "<animation-charging>";
+static constexpr auto TAG_BAR_CAPACITY = "<bar-capacity>";
+static constexpr auto TAG_RAMP_CAPACITY = "<ramp-capacity>";
+static constexpr auto TAG_LABEL_CHARGING = "<label-charging>";
+static constexpr auto TAG_LABEL_DISCHARGING = "<label-discharging>";
+static constexpr auto TAG_LABEL_FULL = "<label-full>";
+
+/**
+ * Mimics the build() of the battery module before the formats were compiled
+ */
+bool build_by_name(string& output, string tag) {
+  if (tag == TAG_ANIMATION_CHARGING)
+    output += "A";
+  else if (tag == TAG_BAR_CAPACITY)
+    output += "B";
+  else if (tag == TAG_RAMP_CAPACITY)
+    output += "R";
+  else if (tag == TAG_LABEL_CHARGING)
+    output += "C";
+  else if (tag == TAG_LABEL_DISCHARGING)
+    output += "D";
+  else if (tag == TAG_LABEL_FULL)
+    output += "F";
+  else
+    return false;
+  return true;
+}
+
+bool build_by_id(string& output, format_util::tag_t tag) {
+  switch (tag) {
+    case format_util::tag_id(TAG_ANIMATION_CHARGING):
+      output += "A";
+      break;
+    case format_util::tag_id(TAG_BAR_CAPACITY):
+      output += "B";
+      break;
+    case format_util::tag_id(TAG_RAMP_CAPACITY):
+      output += "R";
+      break;
+    case format_util::tag_id(TAG_LABEL_CHARGING):
+      output += "C";
+      break;
+    case format_util::tag_id(TAG_LABEL_DISCHARGING):
+      output += "D";
+      break;
+    case format_util::tag_id(TAG_LABEL_FULL):
+      output += "F";
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+int main() {
+  const string format{"<ramp-capacity> <label-discharging> <bar-capacity>"};
+  const auto chunks = format_util::compile(format);
+
+  benchmark__("split_and_compare", 1000000, 0, [&] {
+    string output;
+    for (auto tag : string_util::split(format, ' ')) {
+      if (format_util::is_tag(tag))
+        build_by_name(output, tag);
+      else
+        output += tag;
+    }
+    do_not_optimize__(output);
+  });
+
+  benchmark__("compiled_and_switch", 1000000, 0, [&] {
+    string output;
+    for (auto&& chunk : chunks) {
+      if (chunk.tag != 0)
+        build_by_id(output, chunk.tag);
+      else
+        output += chunk.text;
+    }
+    do_not_optimize__(output);
+  });
+}
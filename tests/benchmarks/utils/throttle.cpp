@@ -0,0 +1,15 @@
+#include "utils/throttle.hpp"
+
+int main() {
+  using namespace lemonbuddy;
+
+  auto throttler = throttle_util::make_throttler(1000, 1ms);
+  throttle_util::token_bucket bucket{1e6, 1000.0};
+  throttle_util::ring_window<1024> window{1000, 1ms};
+  throttle_util::debouncer debounce{1ms, [] {}};
+
+  benchmark__("event_throttler", 1000000, 0, [&] { do_not_optimize__(throttler->passthrough()); });
+  benchmark__("token_bucket", 1000000, 0, [&] { do_not_optimize__(bucket.take()); });
+  benchmark__("ring_window", 1000000, 0, [&] { do_not_optimize__(window.passthrough()); });
+  benchmark__("debouncer", 1000000, 0, [&] { debounce.trigger(); });
+}
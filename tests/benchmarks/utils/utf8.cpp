@@ -0,0 +1,18 @@
+#include "utils/utf8.hpp"
+
+int main() {
+  using namespace lemonbuddy;
+
+  string ascii;
+  string mixed;
+
+  for (int i = 0; i < 64; i++) {
+    ascii += "CPU 12% MEM 3.4G wlan0 connected ";
+    mixed += "CPU 12% \xe2\x96\x81\xe2\x96\x83 MEM \xef\x80\x87 Ku\xc3\x9f\xf0\x9f\x94\x8a ";
+  }
+
+  benchmark__("decode ascii", 10000, ascii.length(), [&] { do_not_optimize__(utf8_util::decode(ascii)); });
+  benchmark__("decode mixed", 10000, mixed.length(), [&] { do_not_optimize__(utf8_util::decode(mixed)); });
+  benchmark__("validate ascii", 10000, ascii.length(), [&] { do_not_optimize__(utf8_util::validate(ascii)); });
+  benchmark__("validate mixed", 10000, mixed.length(), [&] { do_not_optimize__(utf8_util::validate(mixed)); });
+}
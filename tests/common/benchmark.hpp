@@ -0,0 +1,31 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+/**
+ * Prevent the compiler from optimizing away a benchmarked value
+ */
+template <class T>
+void do_not_optimize__(const T& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * Run the given function and report the average time per iteration
+ */
+template <class Function>
+void benchmark__(const char* name, size_t iterations, size_t bytes, const Function& fn) {
+  using clock = std::chrono::steady_clock;
+
+  for (size_t i = 0; i < iterations / 10 + 1; i++) fn();
+
+  auto start = clock::now();
+  for (size_t i = 0; i < iterations; i++) fn();
+  auto ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+  if (bytes > 0)
+    std::printf("%-32s %10.1f ns/op %10.1f MB/s\n", name, ns / iterations, bytes * iterations * 1e3 / ns);
+  else
+    std::printf("%-32s %10.1f ns/op\n", name, ns / iterations);
+}
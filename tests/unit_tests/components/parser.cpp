@@ -0,0 +1,27 @@
+#include "components/parser.hpp"
+
+int main() {
+  using namespace lemonbuddy;
+
+  "text"_test = [] {
+    string output;
+    g_signals::parser::ascii_text_write = [&](string text) { output += text; };
+
+    parser p{bar_settings{}};
+    p("foo%{F-}bar");
+    expect(output == "foobar");
+  };
+
+  "unterminated"_test = [] {
+    string output;
+    g_signals::parser::ascii_text_write = [&](string text) { output += text; };
+
+    parser p{bar_settings{}};
+    p("foo%{bar");
+    expect(output == "foo%{bar");
+
+    output.clear();
+    p("%{");
+    expect(output == "%{");
+  };
+}
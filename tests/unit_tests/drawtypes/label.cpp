@@ -0,0 +1,46 @@
+#include "drawtypes/label.hpp"
+
+int main() {
+  using namespace lemonbuddy;
+  using drawtypes::label;
+
+  "replace_token"_test = [] {
+    label l{"%title% - %artist% (%title%)"};
+    expect(l.get() == "%title% - %artist% (%title%)");
+
+    l.replace_token("%title%", "a %artist% b");
+    l.replace_token("%artist%", "x");
+    expect(l.get() == "a %artist% b - x (a %artist% b)");
+
+    l.reset_tokens();
+    l.replace_token("%artist%", "y");
+    expect(l.get() == "%title% - y (%title%)");
+  };
+
+  "literal_percent"_test = [] {
+    label l{"50% of %percentage%%"};
+    l.replace_token("%percentage%", "25");
+    expect(l.get() == "50% of 25%");
+    expect(l.has_token("%percentage%"));
+    expect(!l.has_token("%of%"));
+  };
+
+  "maxlen"_test = [] {
+    label l{"abc %token% def"};
+    l.replace_token("%token%", "1234");
+    expect(l.get(0) == "abc 1234 def");
+    expect(l.get(6) == "abc 12...");
+    expect(l.get(12) == "abc 1234 def");
+
+    l.m_ellipsis = false;
+    expect(l.get(6) == "abc 12");
+  };
+
+  "clone"_test = [] {
+    label l{"%name%"};
+    l.replace_token("%name%", "one");
+    auto copy = l.clone();
+    expect(copy->get() == "%name%");
+    expect(l.get() == "one");
+  };
+}
@@ -0,0 +1,45 @@
+#include "utils/cache.hpp"
+
+int main() {
+  using namespace lemonbuddy;
+
+  "find"_test = [] {
+    cache_util::lru_cache<string, int> cache{4};
+    expect(cache.find("foo") == nullptr);
+    cache.insert("foo", 1);
+    expect(cache.find("foo") != nullptr);
+    expect(*cache.find("foo") == 1);
+    cache.insert("foo", 2);
+    expect(*cache.find("foo") == 2);
+    expect(cache.size() == 1);
+  };
+
+  "evict"_test = [] {
+    cache_util::lru_cache<int, int> cache{2};
+    cache.insert(1, 10);
+    cache.insert(2, 20);
+    cache.find(1);
+    cache.insert(3, 30);
+    expect(cache.size() == 2);
+    expect(cache.find(1) != nullptr);
+    expect(cache.find(2) == nullptr);
+    expect(cache.find(3) != nullptr);
+    cache.clear();
+    expect(cache.size() == 0);
+  };
+
+  "hit_rate"_test = [] {
+    cache_util::lru_cache<int, int> cache{2};
+    expect(cache.hit_rate() == 0.0f);
+    cache.insert(1, 10);
+    cache.find(1);
+    cache.find(1);
+    cache.find(1);
+    cache.find(2);
+    expect(cache.hits() == 3);
+    expect(cache.misses() == 1);
+    expect(cache.hit_rate() == 75.0f);
+    cache.reset_stats();
+    expect(cache.hits() == 0);
+  };
+}
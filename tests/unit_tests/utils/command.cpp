@@ -0,0 +1,54 @@
+#include <chrono>
+
+#include "utils/command.hpp"
+
+int main() {
+  using namespace lemonbuddy;
+
+  auto wait_idle = [](command_util::runner_t& runner) {
+    for (int i = 0; i < 200 && !runner->idle(); i++) {
+      this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    return runner->idle();
+  };
+
+  "runner_output"_test = [&] {
+    auto runner = command_util::make_runner();
+    vector<string> lines;
+    auto callback = [&](string line) { lines.emplace_back(line); };
+    expect(runner->run("/bin/sh\n-c\necho foo; echo bar; printf baz", callback));
+    expect(wait_idle(runner));
+    expect(lines.size() == 3);
+    expect(lines[0] == "foo");
+    expect(lines[1] == "bar");
+    expect(lines[2] == "baz");
+  };
+
+  "runner_nonblocking"_test = [&] {
+    auto runner = command_util::make_runner();
+    auto start = std::chrono::steady_clock::now();
+    expect(runner->run("sleep 0.3"));
+    expect(std::chrono::steady_clock::now() - start < std::chrono::milliseconds{100});
+    expect(!runner->idle());
+    expect(wait_idle(runner));
+  };
+
+  "runner_drop"_test = [&] {
+    auto runner = command_util::make_runner(1, command_util::repeat_policy::DROP);
+    expect(runner->run("sleep 0.1"));
+    expect(!runner->run("sleep 0.1"));
+    expect(runner->run("sleep 0.05"));
+    expect(wait_idle(runner));
+    expect(runner->run("sleep 0.1"));
+    expect(wait_idle(runner));
+  };
+
+  "runner_queue"_test = [&] {
+    auto runner = command_util::make_runner(1, command_util::repeat_policy::QUEUE);
+    size_t count = 0;
+    auto callback = [&](string) { count++; };
+    for (int i = 0; i < 3; i++) expect(runner->run("/bin/sh\n-c\nsleep 0.05; echo x", callback));
+    expect(wait_idle(runner));
+    expect(count == 3);
+  };
+}
@@ -0,0 +1,45 @@
+#include "utils/format.hpp"
+#include "utils/string.hpp"
+
+int main() {
+  using namespace lemonbuddy;
+
+  "tag_id"_test = [] {
+    static constexpr auto TAG_LABEL = "<label>";
+    constexpr auto id = format_util::tag_id(TAG_LABEL);
+
+    expect(id != 0);
+    expect(format_util::tag_id(string{"<label>"}) == id);
+    expect(format_util::tag_id("<label-full>") != id);
+  };
+
+  "is_tag"_test = [] {
+    expect(format_util::is_tag("<label>"));
+    expect(format_util::is_tag("<>"));
+    expect(!format_util::is_tag("<"));
+    expect(!format_util::is_tag("label"));
+    expect(!format_util::is_tag(""));
+  };
+
+  "compile"_test = [] {
+    auto chunks = format_util::compile("<ramp> text  <label>");
+
+    expect(chunks.size() == 4);
+    expect(chunks[0].tag == format_util::tag_id("<ramp>") && chunks[0].text == "<ramp>");
+    expect(chunks[1].tag == 0 && chunks[1].text == "text");
+    expect(chunks[2].tag == 0 && chunks[2].text.empty());
+    expect(chunks[3].tag == format_util::tag_id("<label>"));
+  };
+
+  "compile_split"_test = [] {
+    for (auto&& format : {"", "<a>", "<a> ", " <a>", "<a>  <b>", "a b  c   "}) {
+      auto chunks = format_util::compile(format);
+      auto words = string_util::split(format, ' ');
+
+      expect(chunks.size() == words.size());
+      for (size_t i = 0; i < chunks.size() && i < words.size(); i++) {
+        expect(chunks[i].text == words[i]);
+      }
+    }
+  };
+}
@@ -0,0 +1,53 @@
+#include "utils/image.hpp"
+
+int main() {
+  using namespace lemonbuddy;
+
+  "parse_xpm"_test = [] {
+    auto img = image_util::parse_xpm(
+        "/* XPM */\n"
+        "static char * icon[] = {\n"
+        "\"3 2 3 1\",\n"
+        "\"  c None\",\n"
+        "\". c #ff0000\",\n"
+        "\"+ s foo c #0f0\",\n"
+        "\" .+\",\n"
+        "\"+. \"};\n");
+    expect(img.width == 3);
+    expect(img.height == 2);
+    expect(img.pixels.size() == 6);
+    expect(img.pixels[0] == 0x00000000);
+    expect(img.pixels[1] == 0xffff0000);
+    expect(img.pixels[2] == 0xff00ff00);
+    expect(img.pixels[3] == 0xff00ff00);
+  };
+
+  "parse_xpm_colors"_test = [] {
+    auto img = image_util::parse_xpm("\"2 1 2 2\" \"aa c #0000ffff0000\" \"bb c White\" \"aabb\"");
+    expect(img.pixels[0] == 0xff00ff00);
+    expect(img.pixels[1] == 0xffffffff);
+  };
+
+  "parse_xpm_invalid"_test = [] {
+    auto throws = [](string data) {
+      try {
+        image_util::parse_xpm(data);
+      } catch (const image_util::image_error&) {
+        return true;
+      }
+      return false;
+    };
+    expect(throws(""));
+    expect(throws("\"1 1 1 1\" \". c #ff0000\""));
+    expect(throws("\"1 1 1 1\" \". c red\" \".\""));
+    expect(throws("\"1 1 1 1\" \". c #ff00\" \".\""));
+    expect(throws("\"1 1 1 1\" \". c #ff0000\" \"x\""));
+    expect(throws("\"2000 1 1 1\" \". c #ff0000\" \".\""));
+  };
+
+  "premultiply"_test = [] {
+    expect(image_util::premultiply(0xff, 0x80, 0x00, 0xff) == 0xffff8000);
+    expect(image_util::premultiply(0xff, 0xff, 0xff, 0x80) == 0x80808080);
+    expect(image_util::premultiply(0xff, 0xff, 0xff, 0x00) == 0x00000000);
+  };
+}
@@ -0,0 +1,147 @@
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+
+#include "utils/inotify.hpp"
+
+using namespace lemonbuddy;
+
+/**
+ * Collects the events of a watch so the test can wait for them
+ */
+struct event_log {
+  std::mutex mutex;
+  std::condition_variable cond;
+  vector<int> masks;
+
+  inotify_callback callback() {
+    return [this](const lemonbuddy::inotify_event& event) {
+      std::lock_guard<std::mutex> guard(mutex);
+      masks.emplace_back(event.mask);
+      cond.notify_all();
+    };
+  }
+
+  bool wait_for(int mask) {
+    std::unique_lock<std::mutex> guard(mutex);
+    return cond.wait_for(guard, 2s, [&] {
+      return std::find_if(masks.begin(), masks.end(), [&](int m) { return m & mask; }) !=
+             masks.end();
+    });
+  }
+
+  int merged() {
+    std::lock_guard<std::mutex> guard(mutex);
+    int mask{0};
+    for (auto&& m : masks) mask |= m;
+    return mask;
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> guard(mutex);
+    masks.clear();
+  }
+};
+
+void touch(const string& path) {
+  std::ofstream(path, std::ios::app) << "x";
+}
+
+void read_file(const string& path) {
+  string contents;
+  std::ifstream(path) >> contents;
+}
+
+int main() {
+  "persistent"_test = [] {
+    auto path = "/tmp/lemonbuddy-test-" + to_string(getpid()) + ".inotify";
+    touch(path);
+
+    event_log log;
+    inotify_watch watch{path};
+    watch.attach(IN_MODIFY, log.callback());
+
+    touch(path);
+    expect(log.wait_for(IN_MODIFY));
+
+    // The watch stays attached after the first event
+    log.clear();
+    touch(path);
+    expect(log.wait_for(IN_MODIFY));
+
+    watch.remove();
+    unlink(path.c_str());
+  };
+
+  "shared"_test = [] {
+    auto path = "/tmp/lemonbuddy-test-" + to_string(getpid()) + ".inotify";
+    touch(path);
+
+    event_log first, second;
+    inotify_watch a{path}, b{path};
+    a.attach(IN_MODIFY, first.callback());
+    b.attach(IN_MODIFY, second.callback());
+
+    touch(path);
+    expect(first.wait_for(IN_MODIFY));
+    expect(second.wait_for(IN_MODIFY));
+
+    // Removing one watch keeps the other attached
+    a.remove();
+    second.clear();
+    touch(path);
+    expect(second.wait_for(IN_MODIFY));
+
+    b.remove();
+    unlink(path.c_str());
+  };
+
+  "replaced"_test = [] {
+    auto path = "/tmp/lemonbuddy-test-" + to_string(getpid()) + ".inotify";
+    touch(path);
+
+    event_log log;
+    inotify_watch watch{path};
+    watch.attach(IN_MODIFY, log.callback());
+
+    // Editors often write a new file and rename it over the old one
+    touch(path + ".new");
+    rename((path + ".new").c_str(), path.c_str());
+    expect(log.wait_for(IN_IGNORED));
+
+    log.clear();
+    // Wait until the service has attached the watch to the new file
+    inotify_service::instance().sync();
+    touch(path);
+    expect(log.wait_for(IN_MODIFY));
+
+    watch.remove();
+    unlink(path.c_str());
+  };
+
+  "strip_reads"_test = [] {
+    auto path = "/tmp/lemonbuddy-test-" + to_string(getpid()) + ".inotify";
+    touch(path);
+
+    event_log log;
+    inotify_watch watch{path};
+    watch.attach(IN_ALL_EVENTS, log.callback());
+
+    // Reading the file while handling an event only causes read events
+    read_file(path);
+    inotify_service::instance().sync();
+    expect(log.merged() & IN_ACCESS);
+    expect(inotify_util::strip_reads(log.merged()) == 0);
+
+    // A change made at the same time must not be dropped with them
+    log.clear();
+    read_file(path);
+    touch(path);
+    read_file(path);
+    inotify_service::instance().sync();
+    expect(inotify_util::strip_reads(log.merged()) & IN_MODIFY);
+
+    watch.remove();
+    unlink(path.c_str());
+  };
+}
@@ -0,0 +1,37 @@
+#include <unistd.h>
+
+#include "utils/snapshot.hpp"
+
+int main() {
+  using namespace lemonbuddy;
+
+  "escape"_test = [] {
+    expect(snapshot_util::escape("a\tb\nc\\d") == "a\\tb\\nc\\\\d");
+    expect(snapshot_util::unescape(snapshot_util::escape("a\tb\nc\\d\\")) == "a\tb\nc\\d\\");
+    expect(snapshot_util::unescape("trailing\\") == "trailing\\");
+  };
+
+  "serialize"_test = [] {
+    map<string, string> outputs{
+        {"module/date", "%{F#fff}12:00%{F-}"}, {"module/script", "a\tb\nc"}};
+    auto data = snapshot_util::serialize("bar/top", outputs);
+
+    expect(snapshot_util::deserialize("bar/top", data) == outputs);
+    expect(snapshot_util::deserialize("bar/bottom", data).empty());
+    expect(snapshot_util::deserialize("bar/top", "lemonbuddy-snapshot 0\nbar/top\n").empty());
+    expect(snapshot_util::deserialize("bar/top", "").empty());
+  };
+
+  "save"_test = [] {
+    auto path = "/tmp/lemonbuddy-test-" + to_string(getpid()) + ".snapshot";
+    map<string, string> outputs{{"module/cpu", "cpu 4%"}};
+
+    expect(snapshot_util::save(path, snapshot_util::serialize("key", outputs)));
+    expect(snapshot_util::load(path, "key") == outputs);
+    expect(snapshot_util::load(path, "other").empty());
+    expect(snapshot_util::load("", "key").empty());
+
+    unlink(path.c_str());
+    expect(snapshot_util::load(path, "key").empty());
+  };
+}
@@ -0,0 +1,230 @@
+#include <atomic>
+
+#include "utils/threading.hpp"
+
+int main() {
+  using namespace lemonbuddy;
+
+  "spin_lock"_test = [] {
+    threading_util::spin_lock lock;
+    int counter = 0;
+    vector<thread> threads;
+
+    for (int i = 0; i < 4; i++) {
+      threads.emplace_back([&] {
+        for (int n = 0; n < 10000; n++) {
+          std::lock_guard<threading_util::spin_lock> guard(lock);
+          counter++;
+        }
+      });
+    }
+
+    for (auto&& t : threads) t.join();
+
+    expect(counter == 40000);
+  };
+
+  "adaptive_lock"_test = [] {
+    threading_util::adaptive_lock lock;
+    int counter = 0;
+    vector<thread> threads;
+
+    for (int i = 0; i < 4; i++) {
+      threads.emplace_back([&] {
+        for (int n = 0; n < 10000; n++) {
+          std::lock_guard<threading_util::adaptive_lock> guard(lock);
+          counter++;
+        }
+      });
+    }
+
+    for (auto&& t : threads) t.join();
+
+    expect(counter == 40000);
+    expect(lock.try_lock());
+    expect(!lock.try_lock());
+    lock.unlock();
+  };
+
+  "adaptive_lock_contention"_test = [] {
+    // Waiters should sleep while the lock is held across blocking i/o,
+    // which a plain spin lock turns into busy cores
+    threading_util::adaptive_lock lock;
+    threading_util::lock_metrics metrics;
+    lock.set_metrics(&metrics);
+
+    std::atomic<bool> held{false};
+    std::atomic<uint64_t> cpu_ns{0};
+    vector<thread> waiters;
+
+    thread holder([&] {
+      std::lock_guard<threading_util::adaptive_lock> guard(lock);
+      held = true;
+      this_thread::sleep_for(200ms);
+    });
+
+    while (!held) this_thread::yield();
+
+    for (int i = 0; i < 3; i++) {
+      waiters.emplace_back([&] {
+        timespec start, end;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+        { std::lock_guard<threading_util::adaptive_lock> guard(lock); }
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+        cpu_ns += (end.tv_sec - start.tv_sec) * 1000000000UL + end.tv_nsec - start.tv_nsec;
+      });
+    }
+
+    holder.join();
+    for (auto&& t : waiters) t.join();
+
+    // About 600ms of waiting in total, of which only the spinning burns cpu
+    expect(cpu_ns < 30000000UL);
+    expect(metrics.acquisitions == 4);
+    expect(metrics.contended == 3);
+    expect(metrics.parks >= 3);
+    expect(metrics.parked_ns > 100000000UL);
+  };
+
+  "publisher"_test = [] {
+    threading_util::publisher<string> value{"foo"};
+    auto before = value.load();
+    value.store("bar");
+    expect(*before == "foo");
+    expect(*value.load() == "bar");
+  };
+
+  "publisher_stress"_test = [] {
+    // Each writer simulates a module publishing new output while a single
+    // reader composes the bar contents, like the controller does
+    const size_t modules = 16;
+    const size_t updates = 5000;
+
+    vector<unique_ptr<threading_util::publisher<string>>> outputs;
+    vector<thread> writers;
+    std::atomic<size_t> running{modules};
+    std::atomic<size_t> torn{0};
+    std::atomic<size_t> reordered{0};
+
+    for (size_t i = 0; i < modules; i++)
+      outputs.emplace_back(
+          make_unique<threading_util::publisher<string>>(string(8, 'a' + i) + "0"));
+
+    for (size_t i = 0; i < modules; i++) {
+      writers.emplace_back([&, i] {
+        for (size_t n = 1; n <= updates; n++) {
+          // The length varies to force reallocations
+          outputs[i]->store(string(8 + n % 64, 'a' + i) + to_string(n));
+        }
+        running--;
+      });
+    }
+
+    vector<size_t> last(modules, 0);
+    size_t reads = 0;
+
+    while (running > 0 || reads == 0) {
+      for (size_t i = 0; i < modules; i++) {
+        auto output = outputs[i]->load();
+        auto digits = output->find_first_of("0123456789");
+
+        if (digits == string::npos || output->find_first_not_of(char('a' + i)) != digits) {
+          torn++;
+          continue;
+        }
+
+        auto version = std::stoul(output->substr(digits));
+        if (version < last[i])
+          reordered++;
+        last[i] = version;
+        reads++;
+      }
+    }
+
+    for (auto&& t : writers) t.join();
+
+    expect(torn == 0);
+    expect(reordered == 0);
+    for (size_t i = 0; i < modules; i++) {
+      expect(*outputs[i]->load() == string(8 + updates % 64, 'a' + i) + to_string(updates));
+    }
+  };
+
+  "publisher_readers"_test = [] {
+    // Several readers keep taking references while the slots get reused
+    threading_util::publisher<string> output{"0"};
+    std::atomic<bool> running{true};
+    std::atomic<size_t> reordered{0};
+    vector<thread> readers;
+
+    for (size_t i = 0; i < 4; i++) {
+      readers.emplace_back([&] {
+        size_t last{0};
+        while (running) {
+          auto value = output.load();
+          auto version = std::stoul(*value);
+          if (version < last)
+            reordered++;
+          last = version;
+        }
+      });
+    }
+
+    for (size_t n = 1; n <= 20000; n++) output.store(to_string(n));
+
+    running = false;
+    for (auto&& t : readers) t.join();
+
+    expect(reordered == 0);
+    expect(*output.load() == "20000");
+  };
+
+  "mailbox"_test = [] {
+    threading_util::mailbox<string> slot;
+    string value;
+
+    expect(slot.put("first"));
+    expect(!slot.put("second"));
+    expect(slot.take(value));
+    expect(value == "second");
+
+    expect(slot.put("third"));
+    slot.clear();
+    expect(slot.put("fourth"));
+    expect(slot.take(value));
+    expect(value == "fourth");
+
+    slot.put("fifth");
+    slot.close();
+    expect(!slot.take(value));
+  };
+
+  "mailbox_latest"_test = [] {
+    // A slow consumer only sees newer values and always gets the last one
+    threading_util::mailbox<size_t> slot;
+    const size_t values = 100000;
+    std::atomic<size_t> last{0};
+    size_t taken = 0;
+    size_t reordered = 0;
+
+    thread consumer([&] {
+      size_t value;
+      while (slot.take(value)) {
+        if (value <= last)
+          reordered++;
+        last = value;
+        taken++;
+      }
+    });
+
+    for (size_t n = 1; n <= values; n++) slot.put(n);
+
+    while (last != values) this_thread::yield();
+
+    slot.close();
+    consumer.join();
+
+    expect(reordered == 0);
+    expect(taken <= values);
+  };
+}
@@ -0,0 +1,101 @@
+#include <atomic>
+
+#include "utils/throttle.hpp"
+
+int main() {
+  using namespace lemonbuddy;
+
+  "token_bucket"_test = [] {
+    throttle_util::token_bucket bucket{20.0, 2.0};
+    expect(bucket.take());
+    expect(bucket.take());
+    expect(!bucket.take());
+    this_thread::sleep_for(60ms);
+    expect(bucket.take());
+    expect(!bucket.take());
+  };
+
+  "token_bucket_concurrent"_test = [] {
+    throttle_util::token_bucket bucket{0.001, 100.0};
+    std::atomic<int> passed{0};
+    vector<thread> threads;
+
+    for (int i = 0; i < 4; i++) {
+      threads.emplace_back([&] {
+        for (int n = 0; n < 1000; n++) {
+          if (bucket.take())
+            passed++;
+        }
+      });
+    }
+
+    for (auto&& t : threads) t.join();
+
+    expect(passed == 100);
+  };
+
+  "ring_window"_test = [] {
+    throttle_util::ring_window<8> window{3, 50ms};
+    expect(window.passthrough());
+    expect(window.passthrough());
+    expect(window.passthrough());
+    expect(!window.passthrough());
+    this_thread::sleep_for(60ms);
+    expect(window.passthrough());
+    expect(window.passthrough());
+    expect(window.passthrough());
+    expect(!window.passthrough());
+  };
+
+  "ring_window_concurrent"_test = [] {
+    throttle_util::ring_window<16> window{10, 10s};
+    std::atomic<int> passed{0};
+    vector<thread> threads;
+
+    for (int i = 0; i < 4; i++) {
+      threads.emplace_back([&] {
+        for (int n = 0; n < 1000; n++) {
+          if (window.passthrough())
+            passed++;
+        }
+      });
+    }
+
+    for (auto&& t : threads) t.join();
+
+    expect(passed == 10);
+  };
+
+  "debouncer"_test = [] {
+    std::atomic<int> calls{0};
+    {
+      throttle_util::debouncer debounce{30ms, [&] { calls++; }};
+
+      for (int i = 0; i < 10; i++) {
+        debounce.trigger();
+        this_thread::sleep_for(5ms);
+      }
+
+      expect(calls == 0);
+      this_thread::sleep_for(80ms);
+      expect(calls == 1);
+
+      debounce.trigger();
+      this_thread::sleep_for(80ms);
+      expect(calls == 2);
+
+      // Pending events are delivered on destruction
+      debounce.trigger();
+    }
+    expect(calls == 3);
+  };
+
+  "event_throttler"_test = [] {
+    auto throttler = throttle_util::make_throttler(2, 50ms);
+    expect(throttler->passthrough());
+    expect(throttler->passthrough());
+    expect(!throttler->passthrough());
+    this_thread::sleep_for(60ms);
+    expect(throttler->passthrough());
+  };
+}
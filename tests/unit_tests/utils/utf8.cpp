@@ -0,0 +1,56 @@
+#include "utils/utf8.hpp"
+
+int main() {
+  using namespace lemonbuddy;
+
+  "ascii_run"_test = [] {
+    string ascii(100, 'a');
+    auto data = reinterpret_cast<const uint8_t*>(ascii.data());
+    expect(utf8_util::ascii_run(data, 0) == 0);
+    expect(utf8_util::ascii_run(data, 7) == 7);
+    expect(utf8_util::ascii_run(data, 100) == 100);
+
+    for (size_t i = 0; i < 40; i++) {
+      string str{ascii.substr(0, i) + "\xc3\xa5" + ascii.substr(0, 40)};
+      auto ptr = reinterpret_cast<const uint8_t*>(str.data());
+      expect(utf8_util::ascii_run(ptr, str.length()) == i);
+    }
+  };
+
+  "decode"_test = [] {
+    expect(utf8_util::decode("abc") == vector<uint32_t>{'a', 'b', 'c'});
+    expect(utf8_util::decode("\xc3\xa5") == vector<uint32_t>{0xe5});
+    expect(utf8_util::decode("\xe2\x82\xac") == vector<uint32_t>{0x20ac});
+    expect(utf8_util::decode("\xf0\x9f\x98\x80") == vector<uint32_t>{0x1f600});
+    expect(utf8_util::decode("\xf4\x8f\xbf\xbf") == vector<uint32_t>{0x10ffff});
+    expect(utf8_util::decode("a\xe2\x82\xac" "b") == vector<uint32_t>{'a', 0x20ac, 'b'});
+  };
+
+  "decode_malformed"_test = [] {
+    auto r = utf8_util::REPLACEMENT_CHAR;
+    // Stray continuation bytes and invalid leads
+    expect(utf8_util::decode("\x80") == vector<uint32_t>{r});
+    expect(utf8_util::decode("a\xbf" "b") == vector<uint32_t>{'a', r, 'b'});
+    expect(utf8_util::decode("\xfe\xff") == vector<uint32_t>{r, r});
+    // Overlong encodings
+    expect(utf8_util::decode("\xc0\xaf") == vector<uint32_t>{r, r});
+    expect(utf8_util::decode("\xe0\x80\xaf") == vector<uint32_t>{r, r, r});
+    expect(utf8_util::decode("\xf0\x80\x80\xaf") == vector<uint32_t>{r, r, r, r});
+    // Surrogates and code points above U+10FFFF
+    expect(utf8_util::decode("\xed\xa0\x80") == vector<uint32_t>{r, r, r});
+    expect(utf8_util::decode("\xf4\x90\x80\x80") == vector<uint32_t>{r, r, r, r});
+    // Truncated sequences only consume the valid prefix
+    expect(utf8_util::decode("\xe2\x82" "a") == vector<uint32_t>{r, 'a'});
+    expect(utf8_util::decode("\xf0\x9f\x98") == vector<uint32_t>{r});
+    expect(utf8_util::decode("\xf0\x9f\xc3\xa5") == vector<uint32_t>{r, 0xe5});
+  };
+
+  "validate"_test = [] {
+    expect(utf8_util::validate(""));
+    expect(utf8_util::validate("abc \xc3\xa5\xe2\x82\xac\xf0\x9f\x98\x80"));
+    expect(utf8_util::validate("\xef\xbf\xbd"));
+    expect(!utf8_util::validate("abc\xff"));
+    expect(!utf8_util::validate("\xe2\x82"));
+    expect(!utf8_util::validate("\xed\xbf\xbf"));
+  };
+}